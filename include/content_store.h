@@ -0,0 +1,216 @@
+#ifndef CONTENT_STORE_H
+#define CONTENT_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class OutputSink;
+
+struct ContentStoreStats {
+    std::uint64_t blobs;
+    std::uint64_t resident_bytes;
+    std::uint64_t spilled_bytes;
+    std::uint64_t live_extent_bytes;   // backing-file space held by spilled blobs
+    std::uint64_t backing_file_bytes;  // high-water length since the file last shrank
+    std::uint64_t evictions;
+    std::uint64_t cache_hits;
+    std::uint64_t cache_misses;
+};
+
+// Where file contents live. Contents are immutable blobs addressed by a
+// handle: writing a file stores a new blob and releases the old one, which
+// also lets a transaction keep the old blob around for rollback.
+class ContentStore {
+public:
+    typedef std::uint32_t Handle;
+    static const Handle kEmpty = 0;  // the empty content, never stored
+
+    virtual ~ContentStore();
+
+    virtual Handle store(const std::string& data) = 0;
+    virtual std::string load(Handle handle) = 0;
+    virtual std::size_t size(Handle handle) const = 0;
+    virtual void release(Handle handle) = 0;
+    virtual ContentStoreStats stats() const = 0;
+
+    // Backing-file failures are reported as errors on this sink (not owned).
+    // A store may be shared, so it is attached by whoever created the store
+    // rather than taken from a file system. Messages raised before a sink is
+    // attached, such as a failed open, are held and delivered then.
+    void setDiagnostics(OutputSink* sink);
+
+protected:
+    ContentStore();
+    void diagnose(const std::string& message);
+
+private:
+    static const std::size_t kMaxPendingDiagnostics = 16;
+
+    OutputSink* diagnostics_;
+    std::vector<std::string> pending_diagnostics_;
+};
+
+// Everything in process memory.
+class MemoryContentStore : public ContentStore {
+public:
+    MemoryContentStore();
+
+    Handle store(const std::string& data) override;
+    std::string load(Handle handle) override;
+    std::size_t size(Handle handle) const override;
+    void release(Handle handle) override;
+    ContentStoreStats stats() const override;
+
+private:
+    std::vector<std::string> blobs_;
+    std::vector<Handle> free_handles_;
+    std::uint64_t live_blobs_;
+    std::uint64_t resident_bytes_;
+};
+
+// Scratch file holding spilled blobs, addressed in fixed-size blocks.
+class BackingFile {
+public:
+    BackingFile();
+    ~BackingFile();
+    BackingFile(const BackingFile&) = delete;
+    BackingFile& operator=(const BackingFile&) = delete;
+
+    bool open(const std::string& path);
+    bool isOpen() const;
+    bool readAt(char* buffer, std::size_t length, std::uint64_t offset) const;
+    bool writeAt(const char* buffer, std::size_t length, std::uint64_t offset);
+    bool truncate(std::uint64_t length);
+
+private:
+#ifdef _WIN32
+    void* handle_;
+#else
+    int fd_;
+#endif
+};
+
+// First-fit allocator of contiguous block runs over a free-space bitmap,
+// scanned a word at a time. Freeing the last run gives the free tail back,
+// so blockCount() is the end of the last block in use.
+class ExtentAllocator {
+public:
+    ExtentAllocator();
+
+    std::uint64_t allocate(std::uint32_t blocks);
+    void free(std::uint64_t start, std::uint32_t blocks);
+    std::uint64_t blockCount() const;
+
+private:
+    void mark(std::uint64_t start, std::uint32_t blocks, bool used);
+
+    std::vector<std::uint64_t> bitmap_;
+    std::uint64_t block_count_;
+    std::uint64_t hint_;
+};
+
+// CLOCK-managed cache of backing-file blocks.
+class PageCache {
+public:
+    PageCache(BackingFile& file, std::size_t pages);
+
+    // Returns nullptr if the block could not be read.
+    const char* page(std::uint64_t block);
+    void invalidate(std::uint64_t block);
+    std::size_t capacity() const;
+    std::uint64_t hits() const;
+    std::uint64_t misses() const;
+
+private:
+    struct Frame {
+        std::uint64_t block;
+        bool valid;
+        bool referenced;
+    };
+
+    BackingFile& file_;
+    std::vector<Frame> frames_;
+    std::unique_ptr<char[]> memory_;
+    std::unordered_map<std::uint64_t, std::size_t> index_;
+    std::size_t hand_;
+    std::uint64_t hits_;
+    std::uint64_t misses_;
+};
+
+// Keeps recently written blobs in memory up to a byte budget and evicts
+// the rest, chosen by CLOCK, to a backing file. Spilled blobs stay on disk
+// and are read back block by block through the page cache. Blobs of up to
+// half a block share blocks: each size class packs them into slabs of
+// power-of-two slots, so small files do not take a whole block each.
+class SpillContentStore : public ContentStore {
+public:
+    static const std::size_t kBlockSize = 4096;
+
+    SpillContentStore(const std::string& backing_path, std::size_t memory_budget,
+                      std::size_t page_cache_bytes);
+
+    bool isOpen() const;
+
+    Handle store(const std::string& data) override;
+    std::string load(Handle handle) override;
+    std::size_t size(Handle handle) const override;
+    void release(Handle handle) override;
+    ContentStoreStats stats() const override;
+
+private:
+    static const std::size_t kMinSlotSize = 32;
+    static const std::size_t kSizeClasses = 7;  // slots of 32 .. 2048 bytes
+
+    struct Blob {
+        std::string data;       // only while resident
+        std::uint64_t size;
+        std::uint64_t offset;   // byte offset in the backing file once spilled
+        std::uint32_t blocks;   // extent length; 0 when packed into a slab
+        std::uint32_t slab;     // packed blobs only
+        bool live;
+        bool resident;
+        bool referenced;
+    };
+
+    // One block divided into equal slots for blobs of one size class.
+    struct Slab {
+        std::uint64_t block;
+        std::uint64_t used[kBlockSize / kMinSlotSize / 64];  // one bit per slot
+        std::uint32_t size_class;
+        std::uint32_t live;
+    };
+
+    void enforceBudget();
+    bool evict(Blob& blob);
+    bool allocateSlot(std::size_t size_class, std::uint32_t& slab, std::uint64_t& offset);
+    void freeSlot(std::uint32_t slab, std::uint64_t offset);
+    void freeBlocks(std::uint64_t start, std::uint32_t blocks);
+    static std::uint32_t blocksFor(std::uint64_t bytes);
+    static std::size_t slotSize(std::size_t size_class);
+    static std::size_t slotsPerSlab(std::size_t size_class);
+
+    BackingFile file_;
+    ExtentAllocator allocator_;
+    PageCache cache_;
+    std::size_t memory_budget_;
+
+    std::vector<Blob> blobs_;
+    std::vector<Handle> free_handles_;
+    std::vector<Slab> slabs_;
+    std::vector<std::uint32_t> free_slabs_;                  // unused entries of slabs_
+    std::vector<std::vector<std::uint32_t>> partial_slabs_;  // per class, slabs with a free slot
+    std::size_t hand_;
+    std::uint64_t live_blobs_;
+    std::uint64_t resident_bytes_;
+    std::uint64_t spilled_bytes_;
+    std::uint64_t extent_bytes_;
+    std::uint64_t file_blocks_;  // high-water block count since the last shrink
+    std::uint64_t evictions_;
+    bool spill_failed_;
+};
+
+#endif // CONTENT_STORE_H
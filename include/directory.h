@@ -2,6 +2,7 @@
 #define DIRECTORY_H
 
 #include "filesystem_node.h"
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <vector>
@@ -11,12 +12,15 @@ class File;  // Forward declaration
 
 class Directory : public FileSystemNode {
 public:
-    Directory(const std::string& name, Directory* parent);
+    Directory(const std::string& name, Directory* parent, NamePool& names);
     ~Directory() override;
 
     bool isDirectory() const override;
-    void listContents(int indent = 0) const override;
+    // Walks the subtree with an explicit stack, so depth is not bounded by
+    // the call stack.
+    void listContents(OutputSink& out, int depth = 0) const override;
 
+    // Returns false if the name is already taken.
     bool addChild(std::unique_ptr<FileSystemNode> child);
     bool removeChild(const std::string& name);
     FileSystemNode* getChild(const std::string& name) const;
@@ -27,8 +31,22 @@ public:
     std::unique_ptr<FileSystemNode> removeChildAndReturn(const std::string& name);
     void insertChild(const std::string& name, std::unique_ptr<FileSystemNode> child);
 
+    // Adds the number of nodes below this directory and the bytes held by
+    // the files among them.
+    void measureSubtree(std::uint64_t& nodes, std::uint64_t& bytes) const;
+
 private:
-    std::map<std::string, std::unique_ptr<FileSystemNode>> children_;
+    // Children are keyed by their interned name, compared by value; lookups
+    // take a plain string.
+    struct NameLess {
+        typedef void is_transparent;
+        bool operator()(const std::string* a, const std::string* b) const { return *a < *b; }
+        bool operator()(const std::string* a, const std::string& b) const { return *a < b; }
+        bool operator()(const std::string& a, const std::string* b) const { return a < *b; }
+    };
+    typedef std::map<const std::string*, std::unique_ptr<FileSystemNode>, NameLess> ChildMap;
+
+    ChildMap children_;
 };
 
 #endif // DIRECTORY_H
\ No newline at end of file
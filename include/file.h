@@ -2,20 +2,26 @@
 #define FILE_H
 
 #include "filesystem_node.h"
+#include "content_store.h"
 #include <string>
 
 class File : public FileSystemNode {
 public:
-    File(const std::string& name, Directory* parent);
+    File(const std::string& name, Directory* parent, NamePool& names, ContentStore& store);
+    ~File() override;
 
     bool isDirectory() const override;
-    void listContents(int indent = 0) const override;
+    void listContents(OutputSink& out, int depth = 0) const override;
 
     void setContent(const std::string& content);
-    const std::string& getContent() const;
+    std::string getContent() const;
+    std::size_t getSize() const;
+    // Swaps in another blob without releasing the old one, which is returned.
+    ContentStore::Handle exchangeContent(ContentStore::Handle content);
 
 private:
-    std::string content_;
+    ContentStore& store_;
+    ContentStore::Handle content_;
 };
 
 #endif // FILE_H
\ No newline at end of file
@@ -1,16 +1,46 @@
 #ifndef FILESYSTEM_H
 #define FILESYSTEM_H
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "content_store.h"
+#include "output_sink.h"
+#include "trace.h"
+#include "watch.h"
+
 class FileSystemNode;
 class Directory;
+class NamePool;
+class NodePool;
 
 class FileSystem {
 public:
+    // Limits on what one file system may hold; zero means unlimited. Going
+    // over a soft limit prints a warning, an operation that would go over a
+    // hard limit fails.
+    struct Quota {
+        std::uint64_t soft_nodes;
+        std::uint64_t hard_nodes;
+        std::uint64_t soft_bytes;
+        std::uint64_t hard_bytes;
+    };
+
+    // Nodes below the root, and bytes of file content.
+    struct Usage {
+        std::uint64_t nodes;
+        std::uint64_t bytes;
+    };
+
     FileSystem();
+    // Name and node pools are created privately when not given; pass shared
+    // ones to let many file systems keep their trees in the same memory.
+    explicit FileSystem(std::shared_ptr<ContentStore> content_store,
+                        std::shared_ptr<NamePool> names = nullptr,
+                        std::shared_ptr<NodePool> nodes = nullptr);
+    ~FileSystem();
     FileSystem(const FileSystem&) = delete;
     FileSystem& operator=(const FileSystem&) = delete;
 
@@ -20,22 +50,119 @@ public:
     static std::string getBaseName(const std::string& path);
 
     std::string pwd() const;
-    void ls(const std::string& path = ".") const;
+    // The same path without recording a trace entry, for prompts and the like.
+    std::string currentPath() const;
+    bool ls(const std::string& path = ".") const;
     bool cd(const std::string& path);
     bool mkdir(const std::string& path);
     bool touch(const std::string& path);
     bool rm(const std::string& path);
-    void cat(const std::string& path) const;
+    bool cat(const std::string& path) const;
     bool echoToFile(const std::string& content, const std::string& path);
     bool rename(const std::string& path, const std::string& newName);
-    void printTree() const;
+    bool printTree() const;
     void neofetch();
+    void printContentStats() const;
+
+    // Transactions: every mutation between begin() and commit() is recorded in
+    // an undo log so that abort() (or a failed commit) restores the tree.
+    bool begin();
+    bool commit();
+    bool abort();
+    bool inTransaction() const;
+
+    // Change notification: events for watched paths are published to a ring
+    // that any number of readers can follow.
+    int addWatch(const std::string& path, bool recursive = false);
+    bool removeWatch(int wd);
+    WatchReader watchEvents() const;
+
+    // Record every command to a binary trace (nullptr stops tracing). The
+    // writer is not owned and must outlive its use here.
+    void setTrace(TraceWriter* trace);
 
     Directory* getCurrentDirectory() const;
+    ContentStore& getContentStore() const;
+
+    void setQuota(const Quota& quota);
+    const Quota& quota() const;
+    const Usage& usage() const;
+
+    // All listings, contents and diagnostics are rendered by this sink
+    // (a TextSink on stdout/stderr by default).
+    void setOutput(std::unique_ptr<OutputSink> output);
+    OutputSink& output() const;
 
 private:
+    enum class UndoKind { Created, Removed, Content, Renamed };
+
+    // One entry per mutation. Nodes removed inside a transaction are kept
+    // detached here instead of being destroyed, and overwritten contents keep
+    // their blob, so rollback never copies.
+    struct UndoRecord {
+        UndoKind kind;
+        Directory* parent;
+        std::string name;                          // child name (new name for Renamed)
+        std::string old_name;                      // for Renamed
+        ContentStore::Handle old_content;          // for Content
+        std::unique_ptr<FileSystemNode> detached;  // node taken out by rm
+    };
+
+    bool lsImpl(const std::string& path) const;
+    bool cdImpl(const std::string& path);
+    bool mkdirImpl(const std::string& path);
+    bool touchImpl(const std::string& path);
+    bool rmImpl(const std::string& path);
+    bool catImpl(const std::string& path) const;
+    bool echoToFileImpl(const std::string& content, const std::string& path);
+    bool renameImpl(const std::string& path, const std::string& newName);
+    bool printTreeImpl() const;
+    bool beginImpl();
+    bool commitImpl();
+    bool abortImpl();
+
+    template <typename Operation>
+    bool traced(TraceOp op, const std::string& arg1, const std::string& arg2, Operation operation) const;
+
+    // One branch on every mutation when nothing is watched.
+    bool watching() const { return watches_->active(); }
+    WatchManager& watchManager() const;
+
+    void reportError(const std::string& message);
+    bool transactionFailed() const;
+    void rollback();
+
+    template <typename Node, typename... Args>
+    std::unique_ptr<Node> makeNode(Args&&... args);
+
+    // exceedsQuota() checks a growth against the hard limits before an
+    // operation; charge() applies the change afterwards and warns about soft
+    // limits being crossed.
+    bool exceedsQuota(std::uint64_t nodes, std::uint64_t bytes) const;
+    void charge(std::int64_t nodes, std::int64_t bytes);
+    static void measure(const FileSystemNode* node, std::uint64_t& nodes, std::uint64_t& bytes);
+
+    std::shared_ptr<ContentStore> content_store_;
+    std::shared_ptr<NamePool> names_;
+    std::shared_ptr<NodePool> nodes_;
+    std::unique_ptr<OutputSink> output_;
     std::unique_ptr<Directory> root_;
     Directory* current_directory_;
+
+    bool in_transaction_;
+    bool transaction_failed_;
+    Directory* transaction_directory_;
+    std::vector<UndoRecord> undo_log_;
+    std::vector<std::string> deferred_errors_;
+
+    mutable std::unique_ptr<WatchManager> watch_manager_;  // created on first use
+    mutable WatchManager* watches_;  // watch_manager_, or a shared one with no watches
+    TraceWriter* trace_;
+
+    Quota quota_;
+    Usage usage_;
+    bool over_soft_nodes_;
+    bool over_soft_bytes_;
 };
 
 #endif // FILESYSTEM_H
\ No newline at end of file
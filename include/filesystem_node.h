@@ -1,29 +1,41 @@
 #ifndef FILESYSTEM_NODE_H
 #define FILESYSTEM_NODE_H
 
+#include <cstddef>
 #include <string>
-#include <iostream>
 
 class Directory;  // Forward declaration
+class OutputSink;
+class NamePool;
+class NodePool;
 
 class FileSystemNode {
 public:
-    FileSystemNode(const std::string& name, Directory* parent);
+    FileSystemNode(const std::string& name, Directory* parent, NamePool& names);
     virtual ~FileSystemNode();
+    FileSystemNode(const FileSystemNode&) = delete;
+    FileSystemNode& operator=(const FileSystemNode&) = delete;
+
+    // Nodes are allocated from a NodePool with `new (pool) T(...)`, or from
+    // the heap with plain new. Either way they are deleted normally: a small
+    // header in front of the node remembers where it came from.
+    static void* operator new(std::size_t size);
+    static void* operator new(std::size_t size, NodePool& pool);
+    static void operator delete(void* pointer);
+    static void operator delete(void* pointer, NodePool& pool);
 
     const std::string& getName() const;
     Directory* getParent() const;
 
     virtual bool isDirectory() const = 0;
-    virtual void listContents(int indent = 0) const = 0;
+    virtual void listContents(OutputSink& out, int depth = 0) const = 0;
 
     void rename(const std::string& newName);
 
 protected:
-    std::string name_;
+    NamePool& names_;
+    const std::string* name_;  // interned in names_
     Directory* parent_;
-
-    void printIndent(int indent) const;
 };
 
-#endif // FILESYSTEM_NODE_H
\ No newline at end of file
+#endif // FILESYSTEM_NODE_H
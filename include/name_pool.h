@@ -0,0 +1,27 @@
+#ifndef NAME_POOL_H
+#define NAME_POOL_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+// Reference-counted interning of node names. Every node holds a pointer to
+// its pooled name and directories key their children by that pointer, so a
+// name used by many nodes, in one tree or across many, is stored once.
+class NamePool {
+public:
+    NamePool();
+    NamePool(const NamePool&) = delete;
+    NamePool& operator=(const NamePool&) = delete;
+
+    // The returned string stays valid until every intern() of it is released.
+    const std::string* intern(const std::string& name);
+    void release(const std::string* name);
+
+    std::size_t size() const;
+
+private:
+    std::unordered_map<std::string, std::size_t> references_;
+};
+
+#endif // NAME_POOL_H
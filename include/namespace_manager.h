@@ -0,0 +1,51 @@
+#ifndef NAMESPACE_MANAGER_H
+#define NAMESPACE_MANAGER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "content_store.h"
+#include "filesystem.h"
+#include "name_pool.h"
+#include "node_pool.h"
+
+// Hosts many independent file systems ("namespaces") in one process. They
+// share one node pool, one name pool and one content store, so an empty
+// namespace costs little more than its root directory, and each namespace
+// carries its own usage accounting and quota. Because of the shared pools,
+// all namespaces of one manager must be driven from one thread at a time.
+class NamespaceManager {
+public:
+    NamespaceManager();
+    explicit NamespaceManager(std::shared_ptr<ContentStore> content_store);
+    ~NamespaceManager();
+    NamespaceManager(const NamespaceManager&) = delete;
+    NamespaceManager& operator=(const NamespaceManager&) = delete;
+
+    // Returns nullptr if a namespace with this name already exists.
+    FileSystem* create(const std::string& name);
+    FileSystem* create(const std::string& name, const FileSystem::Quota& quota);
+    FileSystem* get(const std::string& name) const;
+    bool destroy(const std::string& name);
+
+    std::size_t size() const;
+    std::vector<std::string> names() const;
+
+    // Usage summed over every namespace.
+    FileSystem::Usage totalUsage() const;
+
+    ContentStore& getContentStore() const;
+    const NamePool& getNamePool() const;
+    const NodePool& getNodePool() const;
+
+private:
+    std::shared_ptr<ContentStore> content_store_;
+    std::shared_ptr<NamePool> names_;
+    std::shared_ptr<NodePool> nodes_;
+    std::unordered_map<std::string, std::unique_ptr<FileSystem>> namespaces_;
+};
+
+#endif // NAMESPACE_MANAGER_H
@@ -0,0 +1,43 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Slab allocator for tree nodes. Small requests are rounded up to a size
+// class and served from per-class free lists carved out of 64 KiB slabs, so
+// file systems sharing a pool reuse each other's freed nodes instead of
+// going to the heap; larger requests fall through to operator new.
+class NodePool {
+public:
+    static const std::size_t kGranularity = 16;
+    static const std::size_t kMaxSize = 256;
+    static const std::size_t kSlabSize = 64 * 1024;
+
+    NodePool();
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    void* allocate(std::size_t size);
+    void deallocate(void* pointer, std::size_t size);
+
+    std::size_t bytesInUse() const;
+    std::size_t bytesReserved() const;  // slabs plus large allocations
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static std::size_t classOf(std::size_t size);
+
+    std::vector<FreeBlock*> free_lists_;
+    std::vector<std::unique_ptr<char[]>> slabs_;
+    char* cursor_;
+    std::size_t remaining_;
+    std::size_t in_use_;
+    std::size_t large_bytes_;
+};
+
+#endif // NODE_POOL_H
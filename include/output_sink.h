@@ -0,0 +1,94 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Everything the file system prints goes through a sink, as structured
+// calls rather than preformatted text, so each sink decides the rendering.
+class OutputSink {
+public:
+    virtual ~OutputSink();
+
+    virtual void text(const std::string& line) = 0;
+    virtual void error(const std::string& message) = 0;
+    virtual void entry(const std::string& name, bool directory) = 0;  // one ls line
+    virtual void treeBegin() = 0;
+    virtual void treeNode(int depth, const std::string& name, bool directory, std::size_t size) = 0;
+    virtual void treeEnd() = 0;
+    virtual void flush() = 0;
+};
+
+// Collects output in large chunks and hands them to the kernel together
+// (writev where available) instead of one write per line.
+class BufferedWriter {
+public:
+    explicit BufferedWriter(int fd);
+    ~BufferedWriter();
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    void append(const char* data, std::size_t length);
+    void append(const std::string& data);
+    void append(char c);
+    void flush();
+
+private:
+    std::string& current();
+
+    int fd_;
+    std::vector<std::string> chunks_;
+    std::size_t used_;  // chunks holding unwritten data
+};
+
+// The classic shell rendering; errors go unbuffered to their own stream.
+class TextSink : public OutputSink {
+public:
+    TextSink(int out_fd = 1, int err_fd = 2);
+
+    void text(const std::string& line) override;
+    void error(const std::string& message) override;
+    void entry(const std::string& name, bool directory) override;
+    void treeBegin() override;
+    void treeNode(int depth, const std::string& name, bool directory, std::size_t size) override;
+    void treeEnd() override;
+    void flush() override;
+
+private:
+    BufferedWriter out_;
+    int err_fd_;
+};
+
+// One JSON object per line, errors included, for tools.
+class JsonSink : public OutputSink {
+public:
+    explicit JsonSink(int fd = 1);
+
+    void text(const std::string& line) override;
+    void error(const std::string& message) override;
+    void entry(const std::string& name, bool directory) override;
+    void treeBegin() override;
+    void treeNode(int depth, const std::string& name, bool directory, std::size_t size) override;
+    void treeEnd() override;
+    void flush() override;
+
+private:
+    void appendString(const std::string& value);
+
+    BufferedWriter out_;
+};
+
+// Discards everything; for benchmarks and replay.
+class NullSink : public OutputSink {
+public:
+    void text(const std::string& line) override;
+    void error(const std::string& message) override;
+    void entry(const std::string& name, bool directory) override;
+    void treeBegin() override;
+    void treeNode(int depth, const std::string& name, bool directory, std::size_t size) override;
+    void treeEnd() override;
+    void flush() override;
+};
+
+#endif // OUTPUT_SINK_H
@@ -0,0 +1,78 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Every public FileSystem command that can appear in a trace.
+enum class TraceOp : std::uint8_t {
+    Pwd, Ls, Cd, Mkdir, Touch, Rm, Cat, Echo, Rename, Tree, Begin, Commit, Abort,
+    Count
+};
+
+const char* traceOpName(TraceOp op);
+int traceOpArgumentCount(TraceOp op);
+
+struct TraceRecord {
+    TraceOp op;
+    bool result;
+    std::uint64_t timestamp_ns;  // since the trace was opened
+    std::string arg1;
+    std::string arg2;
+};
+
+// Binary trace format:
+//   header  "FSTRACE1"
+//   record  u8 op (bit 7 = result) | varint timestamp delta in ns |
+//           per argument: varint length + bytes
+class TraceWriter {
+public:
+    explicit TraceWriter(const std::string& path);
+    ~TraceWriter();
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool isOpen() const;
+    // Nanoseconds since the trace was opened; pass the value taken when the
+    // call started to record().
+    std::uint64_t now() const;
+    void record(TraceOp op, bool result, std::uint64_t timestamp_ns,
+                const std::string& arg1, const std::string& arg2);
+    void flush();
+    std::size_t recordCount() const;
+
+private:
+    void putVarint(std::uint64_t value);
+    void putString(const std::string& value);
+
+    std::ofstream out_;
+    std::string buffer_;
+    std::chrono::steady_clock::time_point start_;
+    std::uint64_t last_timestamp_ns_;
+    std::size_t record_count_;
+};
+
+class TraceReader {
+public:
+    explicit TraceReader(const std::string& path);
+
+    bool isOpen() const;
+    // Returns false at the end of the trace or on a malformed record.
+    bool next(TraceRecord& record);
+    bool corrupted() const;
+
+private:
+    bool getVarint(std::uint64_t& value);
+    bool getString(std::string& value);
+
+    std::string data_;
+    std::size_t offset_;
+    std::uint64_t timestamp_ns_;
+    bool open_;
+    bool corrupted_;
+};
+
+#endif // TRACE_H
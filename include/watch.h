@@ -0,0 +1,128 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class FileSystemNode;
+
+// Event bits, modelled on inotify.
+enum WatchMask : std::uint16_t {
+    WatchCreate     = 1 << 0,
+    WatchDelete     = 1 << 1,
+    WatchModify     = 1 << 2,
+    WatchAttrib     = 1 << 3,
+    WatchMovedFrom  = 1 << 4,
+    WatchMovedTo    = 1 << 5,
+    WatchDeleteSelf = 1 << 6,
+    WatchIgnored    = 1 << 7,   // the watch was removed
+    WatchIsDir      = 1 << 8,
+    WatchTruncated  = 1 << 9,   // name did not fit in a ring slot
+    WatchOverflow   = 1 << 10   // the reader fell behind and lost events
+};
+
+struct WatchEvent {
+    int wd;
+    std::uint16_t mask;
+    std::uint32_t cookie;  // pairs MovedFrom with MovedTo
+    std::string name;      // relative to the watched node, empty for self events
+};
+
+std::string describeWatchMask(std::uint16_t mask);
+
+// Fixed-size broadcast ring: one producer (the file system), any number of
+// readers, each with its own cursor. Slots are guarded by a sequence number
+// so readers never block the producer; a reader that gets lapped sees
+// WatchOverflow and resumes from the newest event.
+class EventRing {
+public:
+    static const std::size_t kDefaultCapacity = 4096;
+    static const std::size_t kNameWords = 12;
+
+    explicit EventRing(std::size_t capacity = kDefaultCapacity);
+    EventRing(const EventRing&) = delete;
+    EventRing& operator=(const EventRing&) = delete;
+
+    void reserve();
+    void publish(int wd, std::uint16_t mask, std::uint32_t cookie, const std::string& name);
+    bool read(std::uint64_t& cursor, WatchEvent& event) const;
+
+    std::uint64_t head() const;
+    std::uint64_t coalesced() const;
+
+private:
+    struct Slot {
+        std::atomic<std::uint64_t> sequence;  // 2*pos+1 while written, 2*pos+2 once published
+        std::atomic<std::uint64_t> header;    // wd | mask << 32 | length << 48
+        std::atomic<std::uint32_t> cookie;
+        mutable std::atomic<std::uint32_t> consumed;
+        std::atomic<std::uint64_t> name[kNameWords];
+    };
+
+    std::size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<std::uint64_t> head_;
+    std::uint64_t coalesced_;
+};
+
+class WatchReader {
+public:
+    explicit WatchReader(const EventRing* ring);
+
+    // Returns false when there is nothing new to read.
+    bool next(WatchEvent& event);
+
+private:
+    const EventRing* ring_;
+    std::uint64_t cursor_;
+};
+
+// Watch table owned by a FileSystem. Mutations call notify() behind an
+// active() check, so an unwatched tree pays for a single branch.
+class WatchManager {
+public:
+    WatchManager();
+
+    bool active() const { return !watches_.empty(); }
+
+    int add(const FileSystemNode* node, bool recursive);
+    bool remove(int wd);
+    WatchReader subscribe() const;
+
+    void notify(const FileSystemNode* node, std::uint16_t mask, std::uint32_t cookie = 0);
+    void forget(const FileSystemNode* root);
+    std::uint32_t nextCookie();
+
+    // Events raised inside a transaction are held until it commits.
+    void defer();
+    void flushDeferred();
+    void discardDeferred();
+
+private:
+    struct WatchEntry {
+        int wd;
+        bool recursive;
+    };
+
+    void emit(int wd, std::uint16_t mask, std::uint32_t cookie, const std::string& name);
+    void unlink(int wd, const FileSystemNode* node);
+
+    std::map<int, const FileSystemNode*> watches_;
+    std::unordered_multimap<const FileSystemNode*, WatchEntry> by_node_;
+    std::size_t recursive_count_;
+    int next_wd_;
+    std::uint32_t next_cookie_;
+
+    bool deferring_;
+    std::vector<WatchEvent> deferred_;
+
+    EventRing ring_;
+};
+
+#endif // WATCH_H
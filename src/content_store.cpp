@@ -0,0 +1,645 @@
+#include "../include/content_store.h"
+#include "../include/output_sink.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+const ContentStore::Handle ContentStore::kEmpty;
+const std::size_t SpillContentStore::kBlockSize;
+const std::size_t ContentStore::kMaxPendingDiagnostics;
+const std::size_t SpillContentStore::kMinSlotSize;
+const std::size_t SpillContentStore::kSizeClasses;
+
+namespace {
+
+std::uint64_t countTrailingZeros(std::uint64_t word) {
+    if (word == 0) return 64;
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    return static_cast<std::uint64_t>(__builtin_ctzll(word));
+#endif
+}
+
+std::uint64_t countLeadingZeros(std::uint64_t word) {
+    if (word == 0) return 64;
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse64(&index, word);
+    return 63 - index;
+#else
+    return static_cast<std::uint64_t>(__builtin_clzll(word));
+#endif
+}
+
+} // namespace
+
+ContentStore::ContentStore()
+    : diagnostics_(nullptr) {}
+
+ContentStore::~ContentStore() = default;
+
+void ContentStore::setDiagnostics(OutputSink* sink) {
+    diagnostics_ = sink;
+    if (!diagnostics_) return;
+    for (const std::string& message : pending_diagnostics_) {
+        diagnostics_->error(message);
+    }
+    pending_diagnostics_.clear();
+}
+
+void ContentStore::diagnose(const std::string& message) {
+    if (diagnostics_) {
+        diagnostics_->error(message);
+    } else if (pending_diagnostics_.size() < kMaxPendingDiagnostics) {
+        pending_diagnostics_.push_back(message);
+    }
+}
+
+MemoryContentStore::MemoryContentStore()
+    : blobs_(1), live_blobs_(0), resident_bytes_(0) {}
+
+ContentStore::Handle MemoryContentStore::store(const std::string& data) {
+    if (data.empty()) return kEmpty;
+
+    Handle handle;
+    if (!free_handles_.empty()) {
+        handle = free_handles_.back();
+        free_handles_.pop_back();
+        blobs_[handle] = data;
+    } else {
+        handle = static_cast<Handle>(blobs_.size());
+        blobs_.push_back(data);
+    }
+    ++live_blobs_;
+    resident_bytes_ += data.size();
+    return handle;
+}
+
+std::string MemoryContentStore::load(Handle handle) {
+    return blobs_[handle];
+}
+
+std::size_t MemoryContentStore::size(Handle handle) const {
+    return blobs_[handle].size();
+}
+
+void MemoryContentStore::release(Handle handle) {
+    if (handle == kEmpty) return;
+    resident_bytes_ -= blobs_[handle].size();
+    std::string().swap(blobs_[handle]);
+    free_handles_.push_back(handle);
+    --live_blobs_;
+}
+
+ContentStoreStats MemoryContentStore::stats() const {
+    ContentStoreStats result = {};
+    result.blobs = live_blobs_;
+    result.resident_bytes = resident_bytes_;
+    return result;
+}
+
+BackingFile::BackingFile()
+#ifdef _WIN32
+    : handle_(INVALID_HANDLE_VALUE) {}
+#else
+    : fd_(-1) {}
+#endif
+
+BackingFile::~BackingFile() {
+#ifdef _WIN32
+    if (handle_ != INVALID_HANDLE_VALUE) CloseHandle(handle_);
+#else
+    if (fd_ >= 0) ::close(fd_);
+#endif
+}
+
+bool BackingFile::open(const std::string& path) {
+#ifdef _WIN32
+    // Removed by the system once the handle is closed.
+    handle_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                          FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    return handle_ != INVALID_HANDLE_VALUE;
+#else
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd_ < 0) return false;
+    // The file only lives as long as the descriptor.
+    ::unlink(path.c_str());
+    return true;
+#endif
+}
+
+bool BackingFile::isOpen() const {
+#ifdef _WIN32
+    return handle_ != INVALID_HANDLE_VALUE;
+#else
+    return fd_ >= 0;
+#endif
+}
+
+bool BackingFile::truncate(std::uint64_t length) {
+#ifdef _WIN32
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(length);
+    return SetFilePointerEx(handle_, position, nullptr, FILE_BEGIN) && SetEndOfFile(handle_);
+#else
+    return ::ftruncate(fd_, static_cast<off_t>(length)) == 0;
+#endif
+}
+
+bool BackingFile::readAt(char* buffer, std::size_t length, std::uint64_t offset) const {
+    std::size_t done = 0;
+    while (done < length) {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset + done);
+        overlapped.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+        DWORD chunk = 0;
+        DWORD request = static_cast<DWORD>(std::min<std::size_t>(length - done, 1u << 30));
+        if (!ReadFile(handle_, buffer + done, request, &chunk, &overlapped)) {
+            if (GetLastError() != ERROR_HANDLE_EOF) return false;
+            chunk = 0;
+        }
+#else
+        ssize_t chunk = ::pread(fd_, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (chunk < 0) return false;
+#endif
+        if (chunk == 0) {
+            // Past the end of the file: the tail of a partial block.
+            std::memset(buffer + done, 0, length - done);
+            return true;
+        }
+        done += static_cast<std::size_t>(chunk);
+    }
+    return true;
+}
+
+bool BackingFile::writeAt(const char* buffer, std::size_t length, std::uint64_t offset) {
+    std::size_t done = 0;
+    while (done < length) {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset + done);
+        overlapped.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+        DWORD chunk = 0;
+        DWORD request = static_cast<DWORD>(std::min<std::size_t>(length - done, 1u << 30));
+        if (!WriteFile(handle_, buffer + done, request, &chunk, &overlapped)) return false;
+#else
+        ssize_t chunk = ::pwrite(fd_, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (chunk <= 0) return false;
+#endif
+        done += static_cast<std::size_t>(chunk);
+    }
+    return true;
+}
+
+ExtentAllocator::ExtentAllocator()
+    : block_count_(0), hint_(0) {}
+
+std::uint64_t ExtentAllocator::allocate(std::uint32_t blocks) {
+    // Every block below hint_ is in use, so first fit starts there. The
+    // bitmap is scanned a word at a time, carrying the free run that ends at
+    // the top of one word into the next; runs inside a word are found by
+    // shift-and over its free bits, so fragmentation costs no extra passes.
+    // Bits past block_count_ read as free, so a run may end past the file.
+    std::uint64_t run_start = block_count_;
+    std::uint64_t run = 0;
+    std::uint64_t start = block_count_;
+    bool found = false;
+    std::size_t words = bitmap_.size();
+
+    for (std::size_t index = static_cast<std::size_t>(hint_ >> 6); index < words && !found; ++index) {
+        std::uint64_t base = static_cast<std::uint64_t>(index) << 6;
+        std::uint64_t word = bitmap_[index];
+        if (base < hint_) word |= (1ULL << (hint_ - base)) - 1;
+
+        std::uint64_t low = countTrailingZeros(word);
+        if (run > 0 && run + low >= blocks) {
+            start = run_start;
+            found = true;
+            break;
+        }
+
+        if (blocks <= 64 && word != 0) {
+            std::uint64_t starts = ~word;
+            std::uint64_t length = 1;
+            while (length < blocks && starts != 0) {
+                std::uint64_t shift = std::min<std::uint64_t>(length, blocks - length);
+                starts &= starts >> shift;
+                length += shift;
+            }
+            if (starts != 0) {
+                start = base + countTrailingZeros(starts);
+                found = true;
+                break;
+            }
+        }
+
+        if (word == 0) {
+            if (run == 0) run_start = base;
+            run += 64;
+            if (run >= blocks) {
+                start = run_start;
+                found = true;
+            }
+        } else {
+            std::uint64_t high = countLeadingZeros(word);
+            run = high;
+            run_start = base + 64 - high;
+        }
+    }
+
+    if (!found) {
+        // No hole is large enough: grow the file, reusing a free tail if any.
+        start = (run > 0) ? std::min(run_start, block_count_) : block_count_;
+    }
+    if (start + blocks > block_count_) {
+        block_count_ = start + blocks;
+        bitmap_.resize(static_cast<std::size_t>((block_count_ + 63) / 64), 0);
+    }
+    mark(start, blocks, true);
+    if (start == hint_) hint_ = start + blocks;
+    return start;
+}
+
+void ExtentAllocator::free(std::uint64_t start, std::uint32_t blocks) {
+    mark(start, blocks, false);
+    hint_ = std::min(hint_, start);
+    if (start + blocks != block_count_) return;
+
+    // The last run went: drop the free tail, a word at a time. Bits past
+    // block_count_ are always clear.
+    while (block_count_ > 0) {
+        std::size_t index = static_cast<std::size_t>((block_count_ - 1) >> 6);
+        std::uint64_t word = bitmap_[index];
+        if (word != 0) {
+            block_count_ = (static_cast<std::uint64_t>(index) << 6) + 64 - countLeadingZeros(word);
+            break;
+        }
+        block_count_ = static_cast<std::uint64_t>(index) << 6;
+    }
+    bitmap_.resize(static_cast<std::size_t>((block_count_ + 63) / 64));
+    hint_ = std::min(hint_, block_count_);
+}
+
+std::uint64_t ExtentAllocator::blockCount() const {
+    return block_count_;
+}
+
+void ExtentAllocator::mark(std::uint64_t start, std::uint32_t blocks, bool used) {
+    std::uint64_t block = start;
+    std::uint64_t end = start + blocks;
+    while (block < end) {
+        std::uint64_t offset = block & 63;
+        std::uint64_t count = std::min<std::uint64_t>(64 - offset, end - block);
+        std::uint64_t bits = (count == 64 ? ~0ULL : ((1ULL << count) - 1)) << offset;
+        if (used) {
+            bitmap_[block >> 6] |= bits;
+        } else {
+            bitmap_[block >> 6] &= ~bits;
+        }
+        block += count;
+    }
+}
+
+PageCache::PageCache(BackingFile& file, std::size_t pages)
+    : file_(file), frames_(pages, Frame{0, false, false}), hand_(0), hits_(0), misses_(0) {
+    if (pages > 0) memory_.reset(new char[pages * SpillContentStore::kBlockSize]);
+}
+
+const char* PageCache::page(std::uint64_t block) {
+    auto it = index_.find(block);
+    if (it != index_.end()) {
+        ++hits_;
+        frames_[it->second].referenced = true;
+        return memory_.get() + it->second * SpillContentStore::kBlockSize;
+    }
+    ++misses_;
+
+    // CLOCK: skip over frames used since the hand last passed them.
+    std::size_t victim;
+    for (;;) {
+        Frame& frame = frames_[hand_];
+        victim = hand_;
+        hand_ = (hand_ + 1) % frames_.size();
+        if (!frame.valid || !frame.referenced) break;
+        frame.referenced = false;
+    }
+
+    Frame& frame = frames_[victim];
+    if (frame.valid) index_.erase(frame.block);
+    frame.valid = false;
+
+    char* data = memory_.get() + victim * SpillContentStore::kBlockSize;
+    if (!file_.readAt(data, SpillContentStore::kBlockSize, block * SpillContentStore::kBlockSize)) {
+        return nullptr;
+    }
+    frame.block = block;
+    frame.valid = true;
+    frame.referenced = true;
+    index_[block] = victim;
+    return data;
+}
+
+void PageCache::invalidate(std::uint64_t block) {
+    auto it = index_.find(block);
+    if (it == index_.end()) return;
+    frames_[it->second].valid = false;
+    index_.erase(it);
+}
+
+std::size_t PageCache::capacity() const {
+    return frames_.size();
+}
+
+std::uint64_t PageCache::hits() const {
+    return hits_;
+}
+
+std::uint64_t PageCache::misses() const {
+    return misses_;
+}
+
+SpillContentStore::SpillContentStore(const std::string& backing_path, std::size_t memory_budget,
+                                     std::size_t page_cache_bytes)
+    : cache_(file_, page_cache_bytes / kBlockSize),
+      memory_budget_(memory_budget),
+      blobs_(1, Blob{std::string(), 0, 0, 0, 0, false, false, false}),
+      partial_slabs_(kSizeClasses),
+      hand_(0),
+      live_blobs_(0),
+      resident_bytes_(0),
+      spilled_bytes_(0),
+      extent_bytes_(0),
+      file_blocks_(0),
+      evictions_(0),
+      spill_failed_(false) {
+    if (!file_.open(backing_path)) {
+        diagnose("content store: cannot open backing file '" + backing_path +
+                 "', keeping all contents in memory");
+        spill_failed_ = true;
+    }
+}
+
+bool SpillContentStore::isOpen() const {
+    return file_.isOpen();
+}
+
+ContentStore::Handle SpillContentStore::store(const std::string& data) {
+    if (data.empty()) return kEmpty;
+
+    Handle handle;
+    if (!free_handles_.empty()) {
+        handle = free_handles_.back();
+        free_handles_.pop_back();
+    } else {
+        handle = static_cast<Handle>(blobs_.size());
+        blobs_.push_back(Blob{std::string(), 0, 0, 0, 0, false, false, false});
+    }
+
+    Blob& blob = blobs_[handle];
+    blob.data = data;
+    blob.size = data.size();
+    blob.offset = 0;
+    blob.blocks = 0;
+    blob.slab = 0;
+    blob.live = true;
+    blob.resident = true;
+    blob.referenced = true;
+
+    ++live_blobs_;
+    resident_bytes_ += blob.size;
+    enforceBudget();
+    return handle;
+}
+
+std::string SpillContentStore::load(Handle handle) {
+    Blob& blob = blobs_[handle];
+    if (blob.resident) {
+        blob.referenced = true;
+        return blob.data;
+    }
+
+    // An extent starts on a block boundary; a packed blob may start inside one.
+    std::string result(static_cast<std::size_t>(blob.size), '\0');
+    std::size_t done = 0;
+    while (done < result.size()) {
+        std::uint64_t position = blob.offset + done;
+        std::size_t within = static_cast<std::size_t>(position % kBlockSize);
+        std::size_t length = std::min<std::size_t>(kBlockSize - within, result.size() - done);
+        bool ok;
+        if (cache_.capacity() == 0) {
+            ok = file_.readAt(&result[done], length, position);
+        } else {
+            const char* page = cache_.page(position / kBlockSize);
+            ok = page != nullptr;
+            if (ok) std::memcpy(&result[done], page + within, length);
+        }
+        if (!ok) {
+            diagnose("content store: read from backing file failed");
+            return std::string();
+        }
+        done += length;
+    }
+    return result;
+}
+
+std::size_t SpillContentStore::size(Handle handle) const {
+    return static_cast<std::size_t>(blobs_[handle].size);
+}
+
+void SpillContentStore::release(Handle handle) {
+    if (handle == kEmpty) return;
+
+    Blob& blob = blobs_[handle];
+    if (blob.resident) {
+        resident_bytes_ -= blob.size;
+        std::string().swap(blob.data);
+    } else {
+        if (blob.blocks > 0) {
+            freeBlocks(blob.offset / kBlockSize, blob.blocks);
+            extent_bytes_ -= static_cast<std::uint64_t>(blob.blocks) * kBlockSize;
+        } else {
+            extent_bytes_ -= slotSize(slabs_[blob.slab].size_class);
+            freeSlot(blob.slab, blob.offset);
+        }
+        spilled_bytes_ -= blob.size;
+    }
+    blob.live = false;
+    blob.resident = false;
+    free_handles_.push_back(handle);
+    --live_blobs_;
+}
+
+ContentStoreStats SpillContentStore::stats() const {
+    ContentStoreStats result = {};
+    result.blobs = live_blobs_;
+    result.resident_bytes = resident_bytes_;
+    result.spilled_bytes = spilled_bytes_;
+    result.live_extent_bytes = extent_bytes_;
+    result.backing_file_bytes = file_blocks_ * kBlockSize;
+    result.evictions = evictions_;
+    result.cache_hits = cache_.hits();
+    result.cache_misses = cache_.misses();
+    return result;
+}
+
+void SpillContentStore::enforceBudget() {
+    if (spill_failed_) return;
+
+    // Two sweeps clear every reference bit, so this always terminates.
+    std::size_t budget = 2 * blobs_.size();
+    while (resident_bytes_ > memory_budget_ && budget-- > 0) {
+        if (hand_ >= blobs_.size()) hand_ = 0;
+        Blob& blob = blobs_[hand_++];
+        if (!blob.live || !blob.resident) continue;
+        if (blob.referenced) {
+            blob.referenced = false;
+            continue;
+        }
+        if (!evict(blob)) return;
+    }
+}
+
+bool SpillContentStore::evict(Blob& blob) {
+    std::uint32_t blocks = 0;
+    std::uint32_t slab = 0;
+    std::uint64_t offset;
+    std::uint64_t extent;
+    if (blob.size <= kBlockSize / 2) {
+        std::size_t size_class = 0;
+        while (slotSize(size_class) < blob.size) ++size_class;
+        if (!allocateSlot(size_class, slab, offset)) return false;
+        extent = slotSize(size_class);
+    } else {
+        blocks = blocksFor(blob.size);
+        offset = allocator_.allocate(blocks) * kBlockSize;
+        extent = static_cast<std::uint64_t>(blocks) * kBlockSize;
+    }
+    file_blocks_ = std::max(file_blocks_, allocator_.blockCount());
+
+    bool written = file_.writeAt(blob.data.data(), blob.data.size(), offset);
+    if (blocks == 0) {
+        // The slab's block may be cached with the slot's previous contents.
+        cache_.invalidate(offset / kBlockSize);
+    }
+    if (!written) {
+        if (blocks > 0) {
+            freeBlocks(offset / kBlockSize, blocks);
+        } else {
+            freeSlot(slab, offset);
+        }
+        diagnose("content store: write to backing file failed, keeping all contents in memory");
+        spill_failed_ = true;
+        return false;
+    }
+
+    blob.offset = offset;
+    blob.blocks = blocks;
+    blob.slab = slab;
+    blob.resident = false;
+    std::string().swap(blob.data);
+
+    resident_bytes_ -= blob.size;
+    spilled_bytes_ += blob.size;
+    extent_bytes_ += extent;
+    ++evictions_;
+    return true;
+}
+
+bool SpillContentStore::allocateSlot(std::size_t size_class, std::uint32_t& slab, std::uint64_t& offset) {
+    std::vector<std::uint32_t>& partial = partial_slabs_[size_class];
+    if (partial.empty()) {
+        std::uint32_t index;
+        if (!free_slabs_.empty()) {
+            index = free_slabs_.back();
+            free_slabs_.pop_back();
+        } else {
+            index = static_cast<std::uint32_t>(slabs_.size());
+            slabs_.push_back(Slab());
+        }
+        Slab& fresh = slabs_[index];
+        fresh.block = allocator_.allocate(1);
+        fresh.size_class = static_cast<std::uint32_t>(size_class);
+        fresh.live = 0;
+        // Bits past the last slot stay set, so they are never handed out.
+        std::size_t slots = slotsPerSlab(size_class);
+        for (std::size_t word = 0; word < sizeof(fresh.used) / sizeof(fresh.used[0]); ++word) {
+            std::size_t first = word * 64;
+            if (slots >= first + 64) {
+                fresh.used[word] = 0;
+            } else if (slots <= first) {
+                fresh.used[word] = ~0ULL;
+            } else {
+                fresh.used[word] = ~0ULL << (slots - first);
+            }
+        }
+        partial.push_back(index);
+    }
+
+    slab = partial.back();
+    Slab& current = slabs_[slab];
+    std::size_t word = 0;
+    while (~current.used[word] == 0) ++word;
+    std::uint64_t bit = countTrailingZeros(~current.used[word]);
+    current.used[word] |= 1ULL << bit;
+    if (++current.live == slotsPerSlab(size_class)) partial.pop_back();
+
+    std::uint64_t slot = static_cast<std::uint64_t>(word) * 64 + bit;
+    offset = current.block * kBlockSize + slot * slotSize(size_class);
+    return true;
+}
+
+void SpillContentStore::freeSlot(std::uint32_t slab, std::uint64_t offset) {
+    Slab& current = slabs_[slab];
+    std::size_t slots = slotsPerSlab(current.size_class);
+    std::vector<std::uint32_t>& partial = partial_slabs_[current.size_class];
+    bool was_full = current.live == slots;
+
+    std::uint64_t slot = (offset % kBlockSize) / slotSize(current.size_class);
+    current.used[slot / 64] &= ~(1ULL << (slot % 64));
+    --current.live;
+
+    if (current.live == 0) {
+        partial.erase(std::find(partial.begin(), partial.end(), slab));
+        freeBlocks(current.block, 1);
+        free_slabs_.push_back(slab);
+    } else if (was_full) {
+        partial.push_back(slab);
+    }
+}
+
+void SpillContentStore::freeBlocks(std::uint64_t start, std::uint32_t blocks) {
+    allocator_.free(start, blocks);
+    for (std::uint32_t i = 0; i < blocks; ++i) {
+        cache_.invalidate(start + i);
+    }
+    // Shrink the file once at least half of it is a free tail, so churn at
+    // the end of the file does not truncate and regrow it on every release.
+    std::uint64_t needed = allocator_.blockCount();
+    if (needed <= file_blocks_ / 2 && file_.truncate(needed * kBlockSize)) {
+        file_blocks_ = needed;
+    }
+}
+
+std::uint32_t SpillContentStore::blocksFor(std::uint64_t bytes) {
+    return static_cast<std::uint32_t>((bytes + kBlockSize - 1) / kBlockSize);
+}
+
+std::size_t SpillContentStore::slotSize(std::size_t size_class) {
+    return kMinSlotSize << size_class;
+}
+
+std::size_t SpillContentStore::slotsPerSlab(std::size_t size_class) {
+    return kBlockSize / slotSize(size_class);
+}
\ No newline at end of file
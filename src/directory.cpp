@@ -1,34 +1,75 @@
 #include "../include/directory.h"
 #include "../include/file.h"
+#include "../include/output_sink.h"
 
-#include <iostream>
 #include <algorithm>
 
-Directory::Directory(const std::string& name, Directory* parent)
-    : FileSystemNode(name, parent) {}
+Directory::Directory(const std::string& name, Directory* parent, NamePool& names)
+    : FileSystemNode(name, parent, names) {}
 
-Directory::~Directory() = default;
+Directory::~Directory() {
+    // Tear the subtree down level by level; the default destructor would
+    // recurse once per directory.
+    std::vector<std::unique_ptr<FileSystemNode>> pending;
+    for (auto& pair : children_) {
+        pending.push_back(std::move(pair.second));
+    }
+    children_.clear();
+
+    while (!pending.empty()) {
+        std::unique_ptr<FileSystemNode> node = std::move(pending.back());
+        pending.pop_back();
+        if (node->isDirectory()) {
+            Directory* dir = static_cast<Directory*>(node.get());
+            for (auto& pair : dir->children_) {
+                pending.push_back(std::move(pair.second));
+            }
+            dir->children_.clear();
+        }
+    }
+}
 
 bool Directory::isDirectory() const {
     return true;
 }
 
-void Directory::listContents(int indent) const {
-    printIndent(indent);
-    std::cout << "+ " << getName() << " (Directory)" << std::endl;
-    for (const auto& pair : children_) {
-        pair.second->listContents(indent + 1);
+void Directory::listContents(OutputSink& out, int depth) const {
+    struct Frame {
+        const Directory* dir;
+        ChildMap::const_iterator next;
+    };
+
+    out.treeNode(depth, getName(), true, 0);
+    std::vector<Frame> stack;
+    stack.push_back(Frame{this, children_.begin()});
+
+    while (!stack.empty()) {
+        Frame& top = stack.back();
+        if (top.next == top.dir->children_.end()) {
+            stack.pop_back();
+            continue;
+        }
+        const FileSystemNode* child = top.next->second.get();
+        ++top.next;
+
+        int childDepth = depth + static_cast<int>(stack.size());
+        if (child->isDirectory()) {
+            const Directory* dir = static_cast<const Directory*>(child);
+            out.treeNode(childDepth, dir->getName(), true, 0);
+            stack.push_back(Frame{dir, dir->children_.begin()});
+        } else {
+            child->listContents(out, childDepth);
+        }
     }
 }
 
 bool Directory::addChild(std::unique_ptr<FileSystemNode> child) {
     if (!child) return false;
-    std::string childName = child->getName();
-    if (children_.find(childName) != children_.end()) {
-        std::cerr << "Error: Item '" << childName << "' already exists in '" << getName() << "'." << std::endl;
+    const std::string* key = &child->getName();
+    if (children_.find(*key) != children_.end()) {
         return false;
     }
-    children_[childName] = std::move(child);
+    children_.emplace(key, std::move(child));
     return true;
 }
 
@@ -69,7 +110,7 @@ std::vector<std::string> Directory::getChildNames() const {
     std::vector<std::string> names;
     names.reserve(children_.size());
     for (const auto& pair : children_) {
-        names.push_back(pair.first);
+        names.push_back(*pair.first);
     }
     return names;
 }
@@ -85,5 +126,29 @@ std::unique_ptr<FileSystemNode> Directory::removeChildAndReturn(const std::strin
 }
 
 void Directory::insertChild(const std::string& name, std::unique_ptr<FileSystemNode> child) {
-    children_[name] = std::move(child);
+    // The key must be the child's own pooled name: a replaced entry's key
+    // would be released along with the node it belonged to.
+    auto it = children_.find(name);
+    if (it != children_.end()) {
+        children_.erase(it);
+    }
+    const std::string* key = &child->getName();
+    children_.emplace(key, std::move(child));
+}
+
+void Directory::measureSubtree(std::uint64_t& nodes, std::uint64_t& bytes) const {
+    std::vector<const Directory*> pending(1, this);
+    while (!pending.empty()) {
+        const Directory* dir = pending.back();
+        pending.pop_back();
+        for (const auto& pair : dir->children_) {
+            const FileSystemNode* child = pair.second.get();
+            ++nodes;
+            if (child->isDirectory()) {
+                pending.push_back(static_cast<const Directory*>(child));
+            } else {
+                bytes += static_cast<const File*>(child)->getSize();
+            }
+        }
+    }
 }
\ No newline at end of file
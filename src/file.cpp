@@ -1,22 +1,37 @@
 #include "../include/file.h"
-#include <iostream>
+#include "../include/output_sink.h"
 
-File::File(const std::string& name, Directory* parent)
-    : FileSystemNode(name, parent), content_("") {}
+File::File(const std::string& name, Directory* parent, NamePool& names, ContentStore& store)
+    : FileSystemNode(name, parent, names), store_(store), content_(ContentStore::kEmpty) {}
+
+File::~File() {
+    store_.release(content_);
+}
 
 bool File::isDirectory() const {
     return false;
 }
 
-void File::listContents(int indent) const {
-    printIndent(indent);
-    std::cout << "- " << getName() << " (File, size=" << content_.length() << ")" << std::endl;
+void File::listContents(OutputSink& out, int depth) const {
+    out.treeNode(depth, getName(), false, getSize());
 }
 
 void File::setContent(const std::string& content) {
-    content_ = content;
+    ContentStore::Handle previous = content_;
+    content_ = store_.store(content);
+    store_.release(previous);
+}
+
+std::string File::getContent() const {
+    return store_.load(content_);
+}
+
+std::size_t File::getSize() const {
+    return store_.size(content_);
 }
 
-const std::string& File::getContent() const {
-    return content_;
+ContentStore::Handle File::exchangeContent(ContentStore::Handle content) {
+    ContentStore::Handle previous = content_;
+    content_ = content;
+    return previous;
 }
\ No newline at end of file
@@ -2,9 +2,9 @@
 #include "../include/directory.h"
 #include "../include/file.h"
 #include "../include/filesystem_node.h"
+#include "../include/name_pool.h"
+#include "../include/node_pool.h"
 
-#include <iostream>
-#include <sstream>
 #include <algorithm>
 
 #ifdef _WIN32
@@ -12,19 +12,77 @@
 #include <psapi.h>
 #endif
 
-FileSystem::FileSystem() {
-    root_ = std::make_unique<Directory>("/", nullptr);
+namespace {
+
+// Stands in for the watch manager of every file system that has none yet,
+// so the mutation paths test watches_->active() and nothing else. It never
+// has watches, so nothing ever calls into it beyond that.
+WatchManager& unwatched() {
+    static WatchManager none;
+    return none;
+}
+
+} // namespace
+
+FileSystem::FileSystem()
+    : FileSystem(std::make_shared<MemoryContentStore>()) {}
+
+FileSystem::FileSystem(std::shared_ptr<ContentStore> content_store,
+                       std::shared_ptr<NamePool> names,
+                       std::shared_ptr<NodePool> nodes)
+    : content_store_(std::move(content_store)),
+      names_(names ? std::move(names) : std::make_shared<NamePool>()),
+      nodes_(std::move(nodes)),
+      output_(std::make_unique<TextSink>()),
+      in_transaction_(false),
+      transaction_failed_(false),
+      transaction_directory_(nullptr),
+      watches_(&unwatched()),
+      trace_(nullptr),
+      quota_(Quota{0, 0, 0, 0}),
+      usage_(Usage{0, 0}),
+      over_soft_nodes_(false),
+      over_soft_bytes_(false) {
+    root_ = makeNode<Directory>("/", nullptr, *names_);
     current_directory_ = root_.get();
 }
 
+FileSystem::~FileSystem() {
+    // An open transaction still owns the blobs its writes replaced. Nodes in
+    // the undo log and the tree release their own contents as they go.
+    for (const UndoRecord& record : undo_log_) {
+        if (record.kind == UndoKind::Content) content_store_->release(record.old_content);
+    }
+}
+
+template <typename Node, typename... Args>
+std::unique_ptr<Node> FileSystem::makeNode(Args&&... args) {
+    if (nodes_) {
+        return std::unique_ptr<Node>(new (*nodes_) Node(std::forward<Args>(args)...));
+    }
+    return std::make_unique<Node>(std::forward<Args>(args)...);
+}
+
+template <typename Operation>
+bool FileSystem::traced(TraceOp op, const std::string& arg1, const std::string& arg2, Operation operation) const {
+    if (!trace_) return operation();
+    std::uint64_t start = trace_->now();
+    bool result = operation();
+    trace_->record(op, result, start, arg1, arg2);
+    return result;
+}
+
 std::vector<std::string> FileSystem::splitPath(const std::string& path) {
     std::vector<std::string> parts;
-    std::stringstream ss(path);
-    std::string part;
-    while (std::getline(ss, part, '/')) {
-        if (!part.empty() && part != ".") {
-            parts.push_back(part);
+    std::size_t start = 0;
+    while (start < path.size()) {
+        std::size_t end = path.find('/', start);
+        if (end == std::string::npos) end = path.size();
+        std::size_t length = end - start;
+        if (length > 0 && !(length == 1 && path[start] == '.')) {
+            parts.emplace_back(path, start, length);
         }
+        start = end + 1;
     }
     return parts;
 }
@@ -86,6 +144,11 @@ std::string FileSystem::getBaseName(const std::string& path) {
 }
 
 std::string FileSystem::pwd() const {
+    if (trace_) trace_->record(TraceOp::Pwd, true, trace_->now(), std::string(), std::string());
+    return currentPath();
+}
+
+std::string FileSystem::currentPath() const {
     if (current_directory_ == root_.get()) return "/";
 
     std::string path = "";
@@ -97,15 +160,19 @@ std::string FileSystem::pwd() const {
     return (path.empty()) ? "/" : path;
 }
 
-void FileSystem::ls(const std::string& path) const {
+bool FileSystem::ls(const std::string& path) const {
+    return traced(TraceOp::Ls, path, std::string(), [&] { return lsImpl(path); });
+}
+
+bool FileSystem::lsImpl(const std::string& path) const {
     FileSystemNode* node = findNode(path);
     if (!node) {
-        std::cerr << "ls: cannot access '" << path << "': No such file or directory" << std::endl;
-        return;
+        output_->error("ls: cannot access '" + path + "': No such file or directory");
+        return false;
     }
 
     if (!node->isDirectory()) {
-        std::cout << node->getName() << std::endl;
+        output_->entry(node->getName(), false);
     } else {
         Directory* dir_node = static_cast<Directory*>(node);
         std::vector<std::string> names = dir_node->getChildNames();
@@ -113,13 +180,20 @@ void FileSystem::ls(const std::string& path) const {
         for (const std::string& name : names) {
             FileSystemNode* child = dir_node->getChild(name);
             if (child) {
-                std::cout << name << (child->isDirectory() ? "/" : "") << std::endl;
+                output_->entry(name, child->isDirectory());
             }
         }
     }
+    return true;
 }
 
 bool FileSystem::cd(const std::string& path) {
+    return traced(TraceOp::Cd, path, std::string(), [&] { return cdImpl(path); });
+}
+
+bool FileSystem::cdImpl(const std::string& path) {
+    if (transactionFailed()) return false;
+
     if (path == "..") {
         if (current_directory_->getParent() != nullptr) {
             current_directory_ = current_directory_->getParent();
@@ -134,192 +208,314 @@ bool FileSystem::cd(const std::string& path) {
         current_directory_ = static_cast<Directory*>(node);
         return true;
     } else if (node && !node->isDirectory()) {
-        std::cerr << "cd: '" << path << "' is not a directory" << std::endl;
+        reportError("cd: '" + path + "' is not a directory");
         return false;
     } else {
-        std::cerr << "cd: '" << path << "': No such file or directory" << std::endl;
+        reportError("cd: '" + path + "': No such file or directory");
         return false;
     }
 }
 
 bool FileSystem::mkdir(const std::string& path) {
+    return traced(TraceOp::Mkdir, path, std::string(), [&] { return mkdirImpl(path); });
+}
+
+bool FileSystem::mkdirImpl(const std::string& path) {
+    if (transactionFailed()) return false;
+
     if (path.empty() || path == "/" || path == "." || path == "..") {
-        std::cerr << "mkdir: invalid path '" << path << "'" << std::endl;
+        reportError("mkdir: invalid path '" + path + "'");
         return false;
     }
 
     std::string baseName = getBaseName(path);
     if (baseName.empty() || baseName == "." || baseName == "..") {
-        std::cerr << "mkdir: invalid directory name in path '" << path << "'" << std::endl;
+        reportError("mkdir: invalid directory name in path '" + path + "'");
         return false;
     }
 
     Directory* parentDir = findParentDirectory(path);
     if (!parentDir) {
-        std::cerr << "mkdir: cannot create directory '" << path << "': Parent directory does not exist" << std::endl;
+        reportError("mkdir: cannot create directory '" + path + "': Parent directory does not exist");
         return false;
     }
 
     if (parentDir->getChild(baseName) != nullptr) {
-        std::cerr << "mkdir: cannot create directory '" << path << "': File or directory already exists" << std::endl;
+        reportError("mkdir: cannot create directory '" + path + "': File or directory already exists");
+        return false;
+    }
+
+    if (exceedsQuota(1, 0)) {
+        reportError("mkdir: cannot create directory '" + path + "': Disk quota exceeded");
         return false;
     }
 
-    auto newDir = std::make_unique<Directory>(baseName, parentDir);
-    return parentDir->addChild(std::move(newDir));
+    auto newDir = makeNode<Directory>(baseName, parentDir, *names_);
+    Directory* created = newDir.get();
+    if (!parentDir->addChild(std::move(newDir))) return false;
+    charge(1, 0);
+    if (watching()) watches_->notify(created, WatchCreate);
+    if (in_transaction_) {
+        undo_log_.push_back(UndoRecord{UndoKind::Created, parentDir, baseName, std::string(), ContentStore::kEmpty, nullptr});
+    }
+    return true;
 }
 
 bool FileSystem::touch(const std::string& path) {
+    return traced(TraceOp::Touch, path, std::string(), [&] { return touchImpl(path); });
+}
+
+bool FileSystem::touchImpl(const std::string& path) {
+    if (transactionFailed()) return false;
+
     if (path.empty() || path == "/" || path == "." || path == "..") {
-        std::cerr << "touch: invalid path '" << path << "'" << std::endl;
+        reportError("touch: invalid path '" + path + "'");
         return false;
     }
 
     std::string baseName = getBaseName(path);
     if (baseName.empty() || baseName == "." || baseName == "..") {
-        std::cerr << "touch: invalid file name in path '" << path << "'" << std::endl;
+        reportError("touch: invalid file name in path '" + path + "'");
         return false;
     }
 
     Directory* parentDir = findParentDirectory(path);
     if (!parentDir) {
-        std::cerr << "touch: cannot create file '" << path << "': Directory does not exist" << std::endl;
+        reportError("touch: cannot create file '" + path + "': Directory does not exist");
         return false;
     }
 
     FileSystemNode* existingNode = parentDir->getChild(baseName);
     if (existingNode != nullptr) {
         if (existingNode->isDirectory()) {
-            std::cerr << "touch: cannot create file '" << path << "': A directory with this name already exists" << std::endl;
+            reportError("touch: cannot create file '" + path + "': A directory with this name already exists");
             return false;
         }
+        if (watching()) watches_->notify(existingNode, WatchAttrib);
         return true;
     }
 
-    auto newFile = std::make_unique<File>(baseName, parentDir);
-    return parentDir->addChild(std::move(newFile));
+    if (exceedsQuota(1, 0)) {
+        reportError("touch: cannot create file '" + path + "': Disk quota exceeded");
+        return false;
+    }
+
+    auto newFile = makeNode<File>(baseName, parentDir, *names_, *content_store_);
+    File* created = newFile.get();
+    if (!parentDir->addChild(std::move(newFile))) return false;
+    charge(1, 0);
+    if (watching()) watches_->notify(created, WatchCreate);
+    if (in_transaction_) {
+        undo_log_.push_back(UndoRecord{UndoKind::Created, parentDir, baseName, std::string(), ContentStore::kEmpty, nullptr});
+    }
+    return true;
 }
 
 bool FileSystem::rm(const std::string& path) {
+    return traced(TraceOp::Rm, path, std::string(), [&] { return rmImpl(path); });
+}
+
+bool FileSystem::rmImpl(const std::string& path) {
+    if (transactionFailed()) return false;
+
     if (path.empty() || path == "/" || path == "." || path == "..") {
-        std::cerr << "rm: invalid path '" << path << "'" << std::endl;
+        reportError("rm: invalid path '" + path + "'");
         return false;
     }
 
     std::string baseName = getBaseName(path);
     if (baseName.empty() || baseName == "." || baseName == "..") {
-        std::cerr << "rm: invalid name in path '" << path << "'" << std::endl;
+        reportError("rm: invalid name in path '" + path + "'");
         return false;
     }
 
     Directory* parentDir = findParentDirectory(path);
     if (!parentDir) {
-        std::cerr << "rm: cannot remove '" << path << "': No such file or directory" << std::endl;
+        reportError("rm: cannot remove '" + path + "': No such file or directory");
         return false;
     }
 
     FileSystemNode* nodeToRemove = parentDir->getChild(baseName);
     if (!nodeToRemove) {
-        std::cerr << "rm: cannot remove '" << path << "': No such file or directory" << std::endl;
+        reportError("rm: cannot remove '" + path + "': No such file or directory");
         return false;
     }
 
     if (nodeToRemove == current_directory_) {
-        std::cerr << "rm: cannot remove current directory '.' " << std::endl;
+        reportError("rm: cannot remove current directory '.' ");
         return false;
     }
 
     Directory* checkParent = current_directory_->getParent();
     while (checkParent != nullptr) {
         if (nodeToRemove == checkParent) {
-            std::cerr << "rm: cannot remove ancestor directory" << std::endl;
+            reportError("rm: cannot remove ancestor directory");
             return false;
         }
         checkParent = checkParent->getParent();
     }
 
+    if (watching()) {
+        watches_->notify(nodeToRemove, WatchDelete);
+        // Inside a transaction the removed subtree keeps its watches until
+        // commit, so an abort puts them back along with the nodes.
+        if (!in_transaction_) watches_->forget(nodeToRemove);
+    }
+
+    std::uint64_t removedNodes = 0;
+    std::uint64_t removedBytes = 0;
+    measure(nodeToRemove, removedNodes, removedBytes);
+    charge(-static_cast<std::int64_t>(removedNodes), -static_cast<std::int64_t>(removedBytes));
+
+    if (in_transaction_) {
+        std::unique_ptr<FileSystemNode> detached = parentDir->removeChildAndReturn(baseName);
+        undo_log_.push_back(UndoRecord{UndoKind::Removed, parentDir, baseName, std::string(), ContentStore::kEmpty,
+                                       std::move(detached)});
+        return true;
+    }
     return parentDir->removeChild(baseName);
 }
 
-void FileSystem::cat(const std::string& path) const {
+bool FileSystem::cat(const std::string& path) const {
+    return traced(TraceOp::Cat, path, std::string(), [&] { return catImpl(path); });
+}
+
+bool FileSystem::catImpl(const std::string& path) const {
     FileSystemNode* node = findNode(path);
     if (!node) {
-        std::cerr << "cat: '" << path << "': No such file or directory" << std::endl;
+        output_->error("cat: '" + path + "': No such file or directory");
+        return false;
     } else if (node->isDirectory()) {
-        std::cerr << "cat: '" << path << "': Is a directory" << std::endl;
+        output_->error("cat: '" + path + "': Is a directory");
+        return false;
     } else {
         File* fileNode = static_cast<File*>(node);
-        std::cout << fileNode->getContent() << std::endl;
+        output_->text(fileNode->getContent());
+        return true;
     }
 }
 
 bool FileSystem::echoToFile(const std::string& content, const std::string& path) {
+    return traced(TraceOp::Echo, content, path, [&] { return echoToFileImpl(content, path); });
+}
+
+bool FileSystem::echoToFileImpl(const std::string& content, const std::string& path) {
+    if (transactionFailed()) return false;
+
     FileSystemNode* node = findNode(path);
     std::string baseName = getBaseName(path);
     Directory* parentDir = findParentDirectory(path);
 
     if (!parentDir) {
-        std::cerr << "echo: cannot write to '" << path << "': Directory does not exist" << std::endl;
+        reportError("echo: cannot write to '" + path + "': Directory does not exist");
         return false;
     }
 
     if (node && node->isDirectory()) {
-        std::cerr << "echo: cannot write to '" << path << "': Is a directory" << std::endl;
+        reportError("echo: cannot write to '" + path + "': Is a directory");
         return false;
     } else if (node) {
         File* fileNode = static_cast<File*>(node);
-        fileNode->setContent(content);
+        std::size_t oldSize = fileNode->getSize();
+        if (content.size() > oldSize && exceedsQuota(0, content.size() - oldSize)) {
+            reportError("echo: cannot write to '" + path + "': Disk quota exceeded");
+            return false;
+        }
+        if (in_transaction_) {
+            ContentStore::Handle oldContent = fileNode->exchangeContent(content_store_->store(content));
+            undo_log_.push_back(UndoRecord{UndoKind::Content, fileNode->getParent(), fileNode->getName(),
+                                           std::string(), oldContent, nullptr});
+        } else {
+            fileNode->setContent(content);
+        }
+        charge(0, static_cast<std::int64_t>(content.size()) - static_cast<std::int64_t>(oldSize));
+        if (watching()) watches_->notify(fileNode, WatchModify);
         return true;
     } else {
         if (baseName.empty() || baseName == "." || baseName == "..") {
-            std::cerr << "echo: invalid file name in path '" << path << "'" << std::endl;
+            reportError("echo: invalid file name in path '" + path + "'");
+            return false;
+        }
+        if (exceedsQuota(1, content.size())) {
+            reportError("echo: cannot write to '" + path + "': Disk quota exceeded");
             return false;
         }
-        auto newFile = std::make_unique<File>(baseName, parentDir);
+        auto newFile = makeNode<File>(baseName, parentDir, *names_, *content_store_);
         newFile->setContent(content);
-        return parentDir->addChild(std::move(newFile));
+        File* created = newFile.get();
+        if (!parentDir->addChild(std::move(newFile))) return false;
+        charge(1, static_cast<std::int64_t>(content.size()));
+        if (watching()) {
+            watches_->notify(created, WatchCreate);
+            watches_->notify(created, WatchModify);
         }
+        if (in_transaction_) {
+            undo_log_.push_back(UndoRecord{UndoKind::Created, parentDir, baseName, std::string(), ContentStore::kEmpty, nullptr});
+        }
+        return true;
     }
+}
 
 bool FileSystem::rename(const std::string& path, const std::string& newName) {
+    return traced(TraceOp::Rename, path, newName, [&] { return renameImpl(path, newName); });
+}
+
+bool FileSystem::renameImpl(const std::string& path, const std::string& newName) {
+    if (transactionFailed()) return false;
+
     if (newName.empty() || newName == "." || newName == "..") {
-        std::cerr << "rename: invalid new name '" << newName << "'" << std::endl;
+        reportError("rename: invalid new name '" + newName + "'");
         return false;
     }
 
     FileSystemNode* node = findNode(path);
     if (!node) {
-        std::cerr << "rename: cannot rename '" << path << "': No such file or directory" << std::endl;
+        reportError("rename: cannot rename '" + path + "': No such file or directory");
         return false;
     }
 
     Directory* parentDir = node->getParent();
     if (!parentDir) {
-        std::cerr << "rename: cannot rename root directory" << std::endl;
+        reportError("rename: cannot rename root directory");
         return false;
     }
 
     if (parentDir->getChild(newName) != nullptr) {
-        std::cerr << "rename: target name '" << newName << "' already exists in directory" << std::endl;
+        reportError("rename: target name '" + newName + "' already exists in directory");
         return false;
     }
 
+    std::uint32_t cookie = 0;
+    if (watching()) {
+        cookie = watches_->nextCookie();
+        watches_->notify(node, WatchMovedFrom, cookie);
+    }
+
     std::string oldName = node->getName();
     std::unique_ptr<FileSystemNode> temp = parentDir->removeChildAndReturn(oldName);
     if (!temp) {
-        std::cerr << "rename: internal error, node not found in parent" << std::endl;
+        reportError("rename: internal error, node not found in parent");
         return false;
     }
 
     temp->rename(newName);
     parentDir->insertChild(newName, std::move(temp));
+    if (watching()) watches_->notify(node, WatchMovedTo, cookie);
+    if (in_transaction_) {
+        undo_log_.push_back(UndoRecord{UndoKind::Renamed, parentDir, newName, oldName, ContentStore::kEmpty, nullptr});
+    }
     return true;
 }
 
-void FileSystem::printTree() const {
-    std::cout << "--- File System Tree ---" << std::endl;
-    root_->listContents(0);
-    std::cout << "------------------------" << std::endl;
+bool FileSystem::printTree() const {
+    return traced(TraceOp::Tree, std::string(), std::string(), [&] { return printTreeImpl(); });
+}
+
+bool FileSystem::printTreeImpl() const {
+    output_->treeBegin();
+    root_->listContents(*output_, 0);
+    output_->treeEnd();
+    return true;
 }
 
 void FileSystem::neofetch() {
@@ -334,22 +530,283 @@ void FileSystem::neofetch() {
         memUsageKB = pmc.WorkingSetSize / 1024;
     }
 
-    std::cout << "==============================" << std::endl;
-    std::cout << "         NEOFETCH INFO        " << std::endl;
-    std::cout << "==============================" << std::endl;
-    std::cout << "Sistema Operacional: " << os_name << std::endl;
-    std::cout << "Memória usada pelo processo: " << memUsageKB << " KB" << std::endl;
-    std::cout << "==============================" << std::endl;
+    output_->text("==============================");
+    output_->text("         NEOFETCH INFO        ");
+    output_->text("==============================");
+    output_->text("Sistema Operacional: " + os_name);
+    output_->text("Memória usada pelo processo: " + std::to_string(memUsageKB) + " KB");
+    output_->text("==============================");
 #else
-    std::cout << "==============================" << std::endl;
-    std::cout << "         NEOFETCH INFO        " << std::endl;
-    std::cout << "==============================" << std::endl;
-    std::cout << "Sistema Operacional: Linux/Unix" << std::endl;
-    std::cout << "Uso de memória não implementado para este sistema." << std::endl;
-    std::cout << "==============================" << std::endl;
+    output_->text("==============================");
+    output_->text("         NEOFETCH INFO        ");
+    output_->text("==============================");
+    output_->text("Sistema Operacional: Linux/Unix");
+    output_->text("Uso de memória não implementado para este sistema.");
+    output_->text("==============================");
 #endif
 }
 
+void FileSystem::printContentStats() const {
+    ContentStoreStats stats = content_store_->stats();
+    std::uint64_t lookups = stats.cache_hits + stats.cache_misses;
+
+    output_->text("Blobs: " + std::to_string(stats.blobs));
+    output_->text("In memory: " + std::to_string(stats.resident_bytes) + " bytes");
+    output_->text("Spilled: " + std::to_string(stats.spilled_bytes) + " bytes in " +
+                  std::to_string(stats.live_extent_bytes) + " bytes of extents (backing file " +
+                  std::to_string(stats.backing_file_bytes) + " bytes)");
+    output_->text("Evictions: " + std::to_string(stats.evictions));
+    std::string cache = "Page cache: " + std::to_string(stats.cache_hits) + " hits, " +
+                        std::to_string(stats.cache_misses) + " misses";
+    if (lookups > 0) {
+        cache += " (" + std::to_string(100 * stats.cache_hits / lookups) + "% hit rate)";
+    }
+    output_->text(cache);
+}
+
 Directory* FileSystem::getCurrentDirectory() const {
     return current_directory_;
+}
+
+ContentStore& FileSystem::getContentStore() const {
+    return *content_store_;
+}
+
+void FileSystem::setQuota(const Quota& quota) {
+    quota_ = quota;
+    charge(0, 0);
+}
+
+const FileSystem::Quota& FileSystem::quota() const {
+    return quota_;
+}
+
+const FileSystem::Usage& FileSystem::usage() const {
+    return usage_;
+}
+
+bool FileSystem::exceedsQuota(std::uint64_t nodes, std::uint64_t bytes) const {
+    return (nodes > 0 && quota_.hard_nodes > 0 && usage_.nodes + nodes > quota_.hard_nodes) ||
+           (bytes > 0 && quota_.hard_bytes > 0 && usage_.bytes + bytes > quota_.hard_bytes);
+}
+
+void FileSystem::charge(std::int64_t nodes, std::int64_t bytes) {
+    usage_.nodes += static_cast<std::uint64_t>(nodes);
+    usage_.bytes += static_cast<std::uint64_t>(bytes);
+
+    // A transaction is judged by where it ends: commit checks again, and an
+    // abort returns to the usage the flags already describe.
+    if (in_transaction_) return;
+
+    // Warn once per crossing, not on every operation while over.
+    bool overNodes = quota_.soft_nodes > 0 && usage_.nodes > quota_.soft_nodes;
+    if (overNodes && !over_soft_nodes_) {
+        output_->error("warning: soft quota exceeded: " + std::to_string(usage_.nodes) + " nodes (limit " +
+                       std::to_string(quota_.soft_nodes) + ")");
+    }
+    over_soft_nodes_ = overNodes;
+
+    bool overBytes = quota_.soft_bytes > 0 && usage_.bytes > quota_.soft_bytes;
+    if (overBytes && !over_soft_bytes_) {
+        output_->error("warning: soft quota exceeded: " + std::to_string(usage_.bytes) + " bytes (limit " +
+                       std::to_string(quota_.soft_bytes) + ")");
+    }
+    over_soft_bytes_ = overBytes;
+}
+
+void FileSystem::measure(const FileSystemNode* node, std::uint64_t& nodes, std::uint64_t& bytes) {
+    nodes = 1;
+    bytes = 0;
+    if (node->isDirectory()) {
+        static_cast<const Directory*>(node)->measureSubtree(nodes, bytes);
+    } else {
+        bytes = static_cast<const File*>(node)->getSize();
+    }
+}
+
+void FileSystem::setOutput(std::unique_ptr<OutputSink> output) {
+    output_->flush();
+    output_ = std::move(output);
+}
+
+OutputSink& FileSystem::output() const {
+    return *output_;
+}
+
+bool FileSystem::begin() {
+    return traced(TraceOp::Begin, std::string(), std::string(), [&] { return beginImpl(); });
+}
+
+bool FileSystem::beginImpl() {
+    if (in_transaction_) {
+        output_->error("begin: a transaction is already in progress");
+        return false;
+    }
+    in_transaction_ = true;
+    transaction_failed_ = false;
+    transaction_directory_ = current_directory_;
+    if (watch_manager_) watch_manager_->defer();
+    return true;
+}
+
+bool FileSystem::commit() {
+    return traced(TraceOp::Commit, std::string(), std::string(), [&] { return commitImpl(); });
+}
+
+bool FileSystem::commitImpl() {
+    if (!in_transaction_) {
+        output_->error("commit: no transaction in progress");
+        return false;
+    }
+
+    if (transaction_failed_) {
+        for (const std::string& message : deferred_errors_) {
+            output_->error(message);
+        }
+        output_->error("commit: transaction failed, rolled back " + std::to_string(undo_log_.size()) + " operation(s)");
+        rollback();
+        return false;
+    }
+
+    // Detached nodes and saved contents are released here, once. Watches on
+    // removed subtrees end now, after the DELETE events that explain why.
+    if (watch_manager_) watch_manager_->flushDeferred();
+    for (const UndoRecord& record : undo_log_) {
+        if (record.kind == UndoKind::Content) {
+            content_store_->release(record.old_content);
+        } else if (record.kind == UndoKind::Removed && watching()) {
+            watches_->forget(record.detached.get());
+        }
+    }
+    undo_log_.clear();
+    in_transaction_ = false;
+    transaction_directory_ = nullptr;
+    charge(0, 0);
+    return true;
+}
+
+bool FileSystem::abort() {
+    return traced(TraceOp::Abort, std::string(), std::string(), [&] { return abortImpl(); });
+}
+
+bool FileSystem::abortImpl() {
+    if (!in_transaction_) {
+        output_->error("abort: no transaction in progress");
+        return false;
+    }
+    rollback();
+    return true;
+}
+
+bool FileSystem::inTransaction() const {
+    return in_transaction_;
+}
+
+void FileSystem::reportError(const std::string& message) {
+    if (in_transaction_) {
+        transaction_failed_ = true;
+        deferred_errors_.push_back(message);
+    } else {
+        output_->error(message);
+    }
+}
+
+bool FileSystem::transactionFailed() const {
+    return in_transaction_ && transaction_failed_;
+}
+
+void FileSystem::rollback() {
+    // Nothing that happened inside the transaction is announced; watches on
+    // nodes created by it are dropped (and that is announced) as they go away.
+    if (watch_manager_) watch_manager_->discardDeferred();
+
+    // Undo in reverse order so every record sees the tree exactly as it was
+    // right after the operation that produced it.
+    for (auto it = undo_log_.rbegin(); it != undo_log_.rend(); ++it) {
+        UndoRecord& record = *it;
+        switch (record.kind) {
+            case UndoKind::Created: {
+                FileSystemNode* created = record.parent->getChild(record.name);
+                if (created) {
+                    if (watching()) watches_->forget(created);
+                    std::uint64_t nodes = 0;
+                    std::uint64_t bytes = 0;
+                    measure(created, nodes, bytes);
+                    charge(-static_cast<std::int64_t>(nodes), -static_cast<std::int64_t>(bytes));
+                }
+                record.parent->removeChild(record.name);
+                break;
+            }
+            case UndoKind::Removed: {
+                std::uint64_t nodes = 0;
+                std::uint64_t bytes = 0;
+                measure(record.detached.get(), nodes, bytes);
+                charge(static_cast<std::int64_t>(nodes), static_cast<std::int64_t>(bytes));
+                record.parent->insertChild(record.name, std::move(record.detached));
+                break;
+            }
+            case UndoKind::Content: {
+                File* file = record.parent->getFile(record.name);
+                if (file) {
+                    std::int64_t newSize = static_cast<std::int64_t>(file->getSize());
+                    content_store_->release(file->exchangeContent(record.old_content));
+                    charge(0, static_cast<std::int64_t>(file->getSize()) - newSize);
+                } else {
+                    content_store_->release(record.old_content);
+                }
+                break;
+            }
+            case UndoKind::Renamed: {
+                std::unique_ptr<FileSystemNode> node = record.parent->removeChildAndReturn(record.name);
+                if (node) {
+                    node->rename(record.old_name);
+                    record.parent->insertChild(record.old_name, std::move(node));
+                }
+                break;
+            }
+        }
+    }
+
+    undo_log_.clear();
+    deferred_errors_.clear();
+    current_directory_ = transaction_directory_;
+    transaction_directory_ = nullptr;
+    in_transaction_ = false;
+    transaction_failed_ = false;
+}
+
+int FileSystem::addWatch(const std::string& path, bool recursive) {
+    FileSystemNode* node = findNode(path);
+    if (!node) {
+        output_->error("watch: cannot watch '" + path + "': No such file or directory");
+        return -1;
+    }
+    return watchManager().add(node, recursive);
+}
+
+bool FileSystem::removeWatch(int wd) {
+    if (!watch_manager_ || !watch_manager_->remove(wd)) {
+        output_->error("unwatch: invalid watch descriptor " + std::to_string(wd));
+        return false;
+    }
+    return true;
+}
+
+WatchReader FileSystem::watchEvents() const {
+    return watchManager().subscribe();
+}
+
+WatchManager& FileSystem::watchManager() const {
+    // Most file systems are never watched, so they do not carry the manager
+    // and its ring until someone asks.
+    if (!watch_manager_) {
+        watch_manager_ = std::make_unique<WatchManager>();
+        if (in_transaction_) watch_manager_->defer();
+        watches_ = watch_manager_.get();
+    }
+    return *watch_manager_;
+}
+
+void FileSystem::setTrace(TraceWriter* trace) {
+    trace_ = trace;
 }
\ No newline at end of file
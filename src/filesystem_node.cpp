@@ -1,13 +1,61 @@
 #include "../include/filesystem_node.h"
 #include "../include/directory.h"
+#include "../include/name_pool.h"
+#include "../include/node_pool.h"
 
-FileSystemNode::FileSystemNode(const std::string& name, Directory* parent)
-    : name_(name), parent_(parent) {}
+namespace {
 
-FileSystemNode::~FileSystemNode() = default;
+struct AllocationHeader {
+    NodePool* pool;    // nullptr for heap nodes
+    std::size_t size;  // bytes requested from the pool, header included
+};
+
+// Keeps the node itself at the alignment operator new guarantees.
+const std::size_t kHeaderSize = 16;
+static_assert(sizeof(AllocationHeader) <= kHeaderSize, "allocation header does not fit");
+
+void* placeHeader(void* block, NodePool* pool, std::size_t size) {
+    AllocationHeader* header = static_cast<AllocationHeader*>(block);
+    header->pool = pool;
+    header->size = size;
+    return static_cast<char*>(block) + kHeaderSize;
+}
+
+} // namespace
+
+FileSystemNode::FileSystemNode(const std::string& name, Directory* parent, NamePool& names)
+    : names_(names), name_(names.intern(name)), parent_(parent) {}
+
+FileSystemNode::~FileSystemNode() {
+    names_.release(name_);
+}
+
+void* FileSystemNode::operator new(std::size_t size) {
+    return placeHeader(::operator new(size + kHeaderSize), nullptr, size + kHeaderSize);
+}
+
+void* FileSystemNode::operator new(std::size_t size, NodePool& pool) {
+    return placeHeader(pool.allocate(size + kHeaderSize), &pool, size + kHeaderSize);
+}
+
+void FileSystemNode::operator delete(void* pointer) {
+    if (!pointer) return;
+    void* block = static_cast<char*>(pointer) - kHeaderSize;
+    AllocationHeader* header = static_cast<AllocationHeader*>(block);
+    if (header->pool) {
+        header->pool->deallocate(block, header->size);
+    } else {
+        ::operator delete(block);
+    }
+}
+
+void FileSystemNode::operator delete(void* pointer, NodePool&) {
+    // Only called when a constructor throws; the header already knows the pool.
+    FileSystemNode::operator delete(pointer);
+}
 
 const std::string& FileSystemNode::getName() const {
-    return name_;
+    return *name_;
 }
 
 Directory* FileSystemNode::getParent() const {
@@ -15,11 +63,7 @@ Directory* FileSystemNode::getParent() const {
 }
 
 void FileSystemNode::rename(const std::string& newName) {
-    name_ = newName;
+    const std::string* previous = name_;
+    name_ = names_.intern(newName);
+    names_.release(previous);
 }
-
-void FileSystemNode::printIndent(int indent) const {
-    for (int i = 0; i < indent; ++i) {
-        std::cout << "  ";
-    }
-}
\ No newline at end of file
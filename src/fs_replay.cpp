@@ -0,0 +1,651 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/content_store.h"
+#include "../include/filesystem.h"
+#include "../include/namespace_manager.h"
+#include "../include/output_sink.h"
+#include "../include/directory.h"
+#include "../include/trace.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+void printUsage() {
+    std::cerr << "Usage: fs_replay <trace> [--paced] [--spill <backing file> --budget <bytes>]" << std::endl;
+    std::cerr << "       fs_replay --generate <build|log|metadata> <trace> [operations]" << std::endl;
+    std::cerr << "       fs_replay --bench transactions [operations]" << std::endl;
+    std::cerr << "       fs_replay --bench tree [fanout]" << std::endl;
+    std::cerr << "       fs_replay --bench watches [operations]" << std::endl;
+    std::cerr << "       fs_replay --bench <namespaces|standalone> [count]" << std::endl;
+}
+
+bool apply(FileSystem& fs, const TraceRecord& record) {
+    switch (record.op) {
+        case TraceOp::Pwd: fs.pwd(); return true;
+        case TraceOp::Ls: return fs.ls(record.arg1);
+        case TraceOp::Cd: return fs.cd(record.arg1);
+        case TraceOp::Mkdir: return fs.mkdir(record.arg1);
+        case TraceOp::Touch: return fs.touch(record.arg1);
+        case TraceOp::Rm: return fs.rm(record.arg1);
+        case TraceOp::Cat: return fs.cat(record.arg1);
+        case TraceOp::Echo: return fs.echoToFile(record.arg1, record.arg2);
+        case TraceOp::Rename: return fs.rename(record.arg1, record.arg2);
+        case TraceOp::Tree: return fs.printTree();
+        case TraceOp::Begin: return fs.begin();
+        case TraceOp::Commit: return fs.commit();
+        case TraceOp::Abort: return fs.abort();
+        case TraceOp::Count: break;
+    }
+    return false;
+}
+
+double percentile(const std::vector<std::uint64_t>& sorted, int pct) {
+    if (sorted.empty()) return 0.0;
+    std::size_t index = (sorted.size() - 1) * static_cast<std::size_t>(pct) / 100;
+    return static_cast<double>(sorted[index]) / 1000.0;
+}
+
+int replay(const std::string& path, bool paced, std::shared_ptr<ContentStore> store) {
+    TraceReader reader(path);
+    if (!reader.isOpen()) {
+        std::cerr << "fs_replay: cannot read trace '" << path << "'" << std::endl;
+        return 1;
+    }
+
+    std::vector<TraceRecord> records;
+    TraceRecord record;
+    while (reader.next(record)) {
+        records.push_back(record);
+    }
+    if (reader.corrupted()) {
+        std::cerr << "fs_replay: trace is truncated or corrupted after " << records.size() << " records" << std::endl;
+    }
+    if (records.empty()) {
+        std::cerr << "fs_replay: trace is empty" << std::endl;
+        return 1;
+    }
+
+    const std::size_t opCount = static_cast<std::size_t>(TraceOp::Count);
+    std::vector<std::vector<std::uint64_t>> latencies(opCount);
+    std::size_t mismatches = 0;
+    const std::uint64_t firstTimestamp = records.front().timestamp_ns;
+
+    // Replayed commands print what the shell would; none of it matters here.
+    FileSystem fs(store);
+    fs.setOutput(std::make_unique<NullSink>());
+
+    Clock::time_point start = Clock::now();
+    for (const TraceRecord& r : records) {
+        if (paced) {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(r.timestamp_ns - firstTimestamp));
+        }
+        Clock::time_point before = Clock::now();
+        bool result = apply(fs, r);
+        Clock::time_point after = Clock::now();
+        latencies[static_cast<std::size_t>(r.op)].push_back(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count()));
+        if (result != r.result) ++mismatches;
+    }
+    Clock::time_point end = Clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "Replayed " << records.size() << " operations in " << std::fixed << std::setprecision(3)
+              << seconds << " s (" << (paced ? "paced" : "max speed") << ")" << std::endl;
+    std::cout << "Throughput: " << std::setprecision(0) << records.size() / seconds << " ops/s" << std::endl;
+    std::cout << "Result mismatches against the trace: " << mismatches << std::endl;
+    std::cout << std::endl;
+    std::cout << std::left << std::setw(8) << "op" << std::right
+              << std::setw(10) << "count" << std::setw(14) << "ops/s"
+              << std::setw(11) << "p50 us" << std::setw(11) << "p90 us"
+              << std::setw(11) << "p99 us" << std::setw(11) << "max us" << std::endl;
+
+    for (std::size_t op = 0; op < opCount; ++op) {
+        std::vector<std::uint64_t>& samples = latencies[op];
+        if (samples.empty()) continue;
+        std::sort(samples.begin(), samples.end());
+        std::uint64_t total = 0;
+        for (std::uint64_t sample : samples) total += sample;
+        double busySeconds = static_cast<double>(total) / 1e9;
+
+        std::cout << std::left << std::setw(8) << traceOpName(static_cast<TraceOp>(op)) << std::right
+                  << std::setw(10) << samples.size()
+                  << std::setw(14) << std::setprecision(0) << (busySeconds > 0 ? samples.size() / busySeconds : 0.0)
+                  << std::setprecision(2)
+                  << std::setw(11) << percentile(samples, 50)
+                  << std::setw(11) << percentile(samples, 90)
+                  << std::setw(11) << percentile(samples, 99)
+                  << std::setw(11) << static_cast<double>(samples.back()) / 1000.0 << std::endl;
+    }
+
+    std::cout << std::endl;
+    std::cout.flush();
+    fs.setOutput(std::make_unique<TextSink>());
+    fs.printContentStats();
+    return 0;
+}
+
+// Compiler-like workload: a fixed source tree is read over and over while
+// object files are written through a temporary name and renamed into place.
+void generateBuild(FileSystem& fs, const TraceWriter& trace, std::size_t operations, std::mt19937& rng) {
+    const int modules = 16;
+    const int filesPerModule = 32;
+
+    fs.mkdir("/src");
+    for (int m = 0; m < modules; ++m) {
+        std::string module = "/src/mod" + std::to_string(m);
+        fs.mkdir(module);
+        for (int f = 0; f < filesPerModule; ++f) {
+            fs.echoToFile("int f" + std::to_string(f) + "() { return " + std::to_string(f) + "; }",
+                          module + "/f" + std::to_string(f) + ".cpp");
+        }
+    }
+
+    for (int build = 0; trace.recordCount() < operations; ++build) {
+        if (build % 4 == 0) {
+            fs.rm("/build");
+            fs.mkdir("/build");
+        }
+        for (int m = 0; m < modules && trace.recordCount() < operations; ++m) {
+            std::string source = "/src/mod" + std::to_string(m);
+            std::string output = "/build/mod" + std::to_string(m);
+            fs.mkdir(output);
+            fs.ls(source);
+            for (int f = 0; f < filesPerModule && trace.recordCount() < operations; ++f) {
+                std::string name = "f" + std::to_string(f);
+                if (rng() % 8 == 0) {
+                    fs.echoToFile("int " + name + "() { return " + std::to_string(rng()) + "; }",
+                                  source + "/" + name + ".cpp");
+                }
+                fs.cat(source + "/" + name + ".cpp");
+                fs.echoToFile("obj:" + name + ":" + std::to_string(build), output + "/" + name + ".o.tmp");
+                fs.rm(output + "/" + name + ".o");
+                fs.rename(output + "/" + name + ".o.tmp", name + ".o");
+            }
+            fs.touch(output + "/.stamp");
+        }
+    }
+}
+
+// Services appending to their logs, with size-based rotation.
+void generateLog(FileSystem& fs, const TraceWriter& trace, std::size_t operations, std::mt19937& rng) {
+    const int services = 8;
+    const int linesPerLog = 32;
+
+    fs.mkdir("/var");
+    fs.mkdir("/var/log");
+    std::vector<std::string> contents(services);
+    std::vector<int> lines(services, 0);
+
+    for (std::uint64_t sequence = 0; trace.recordCount() < operations; ++sequence) {
+        int service = static_cast<int>(rng() % services);
+        std::string log = "/var/log/svc" + std::to_string(service) + ".log";
+
+        contents[service] += "[" + std::to_string(sequence) + "] request handled\n";
+        fs.echoToFile(contents[service], log);
+
+        if (++lines[service] >= linesPerLog) {
+            fs.rm(log + ".1");
+            fs.rename(log, "svc" + std::to_string(service) + ".log.1");
+            contents[service].clear();
+            lines[service] = 0;
+        }
+        if (rng() % 50 == 0) {
+            fs.cat(log);
+        }
+    }
+}
+
+// Namespace churn with no file data: creates, renames, deletes and listings
+// spread over a few wide directories.
+void generateMetadata(FileSystem& fs, const TraceWriter& trace, std::size_t operations, std::mt19937& rng) {
+    const int directories = 64;
+
+    fs.mkdir("/meta");
+    for (int d = 0; d < directories; ++d) {
+        fs.mkdir("/meta/d" + std::to_string(d));
+    }
+
+    std::vector<std::vector<std::string>> entries(directories);
+    std::uint64_t counter = 0;
+
+    while (trace.recordCount() < operations) {
+        int d = static_cast<int>(rng() % directories);
+        std::string dir = "/meta/d" + std::to_string(d);
+        std::vector<std::string>& names = entries[d];
+        unsigned roll = rng() % 100;
+
+        if (roll < 40 || names.empty()) {
+            std::string name = "e" + std::to_string(counter++);
+            fs.touch(dir + "/" + name);
+            names.push_back(name);
+        } else if (roll < 50) {
+            std::string name = "s" + std::to_string(counter++);
+            fs.mkdir(dir + "/" + name);
+            names.push_back(name);
+        } else if (roll < 65) {
+            std::size_t index = rng() % names.size();
+            std::string name = "r" + std::to_string(counter++);
+            fs.rename(dir + "/" + names[index], name);
+            names[index] = name;
+        } else if (roll < 80) {
+            std::size_t index = rng() % names.size();
+            fs.rm(dir + "/" + names[index]);
+            names[index] = names.back();
+            names.pop_back();
+        } else if (roll < 90) {
+            fs.ls(dir);
+        } else {
+            fs.cd(dir);
+            fs.pwd();
+            fs.cd("/");
+        }
+    }
+}
+
+int generate(const std::string& kind, const std::string& path, std::size_t operations) {
+    if (kind != "build" && kind != "log" && kind != "metadata") {
+        std::cerr << "fs_replay: unknown workload '" << kind << "'" << std::endl;
+        return 1;
+    }
+
+    TraceWriter trace(path);
+    if (!trace.isOpen()) {
+        std::cerr << "fs_replay: cannot write trace '" << path << "'" << std::endl;
+        return 1;
+    }
+
+    FileSystem fs;
+    fs.setOutput(std::make_unique<NullSink>());
+    std::mt19937 rng(42);
+    fs.setTrace(&trace);
+    if (kind == "build") {
+        generateBuild(fs, trace, operations, rng);
+    } else if (kind == "log") {
+        generateLog(fs, trace, operations, rng);
+    } else {
+        generateMetadata(fs, trace, operations, rng);
+    }
+    fs.setTrace(nullptr);
+
+    trace.flush();
+    std::cout << "Wrote " << trace.recordCount() << " operations to '" << path << "'" << std::endl;
+    return 0;
+}
+
+// The same mkdir/touch/echo/rename mix issued one command at a time, in
+// transactions that commit, and in transactions that abort. Transactions
+// exist for atomicity, not speed; the ratio column shows what the undo log
+// costs (or saves) per mutation against plain commands. Aborted batches
+// also leave the tree small, which flatters the abort row.
+int benchTransactions(std::size_t operations) {
+    const std::size_t kBatch = 100;  // operations per transaction
+    const char* modes[] = {"single", "commit", "abort"};
+    double baseline = 0;
+
+    std::cout << std::left << std::setw(10) << "mode" << std::right
+              << std::setw(14) << "ns/op" << std::setw(14) << "ops/s" << std::setw(12) << "vs single" << std::endl;
+
+    for (int mode = 0; mode < 3; ++mode) {
+        FileSystem fs;
+        fs.setOutput(std::make_unique<NullSink>());
+
+        std::size_t performed = 0;
+        std::size_t round = 0;
+        Clock::time_point start = Clock::now();
+        while (performed < operations) {
+            if (mode > 0) fs.begin();
+            for (std::size_t inBatch = 0; inBatch < kBatch && performed < operations; inBatch += 4, ++round) {
+                std::string dir = "/b" + std::to_string(round);
+                fs.mkdir(dir);
+                fs.touch(dir + "/a");
+                fs.echoToFile("batched write", dir + "/a");
+                fs.rename(dir + "/a", "b");
+                performed += 4;
+            }
+            if (mode == 1) fs.commit();
+            if (mode == 2) fs.abort();
+        }
+        Clock::time_point end = Clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double rate = performed / seconds;
+        if (mode == 0) baseline = rate;
+        std::cout << std::left << std::setw(10) << modes[mode] << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(14) << seconds * 1e9 / performed << std::setw(14) << rate
+                  << std::setw(11) << std::setprecision(2) << rate / baseline << "x" << std::endl;
+    }
+    std::cout << kBatch << " operations per transaction" << std::endl;
+    return 0;
+}
+
+// Cost of a mutation with 0, 1 and 1000 watches registered, while one
+// reader thread drains the event ring. The watched directory is where the
+// mutations happen; the other watches sit on unrelated directories.
+int benchWatches(std::size_t operations) {
+    const int counts[] = {0, 1, 1000};
+    std::cout << std::left << std::setw(10) << "watches" << std::right
+              << std::setw(14) << "ns/op" << std::setw(14) << "ops/s"
+              << std::setw(12) << "events" << std::setw(12) << "overflows" << std::endl;
+
+    for (int count : counts) {
+        FileSystem fs;
+        fs.setOutput(std::make_unique<NullSink>());
+        fs.mkdir("/work");
+        fs.mkdir("/other");
+        if (count > 0) fs.addWatch("/work");
+        for (int i = 1; i < count; ++i) {
+            std::string dir = "/other/d" + std::to_string(i);
+            fs.mkdir(dir);
+            fs.addWatch(dir);
+        }
+
+        std::atomic<bool> done(false);
+        std::uint64_t events = 0;
+        std::uint64_t overflows = 0;
+        std::thread reader;
+        if (count > 0) {
+            WatchReader watch = fs.watchEvents();
+            reader = std::thread([&done, &events, &overflows, watch]() mutable {
+                WatchEvent event;
+                for (;;) {
+                    if (watch.next(event)) {
+                        ++events;
+                        if (event.mask & WatchOverflow) ++overflows;
+                    } else if (done.load(std::memory_order_acquire)) {
+                        break;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        // Each round creates, modifies, renames and removes one file.
+        std::size_t performed = 0;
+        Clock::time_point start = Clock::now();
+        for (std::size_t round = 0; performed < operations; ++round) {
+            std::string name = "f" + std::to_string(round % 64);
+            std::string path = "/work/" + name;
+            fs.echoToFile("created", path);
+            fs.echoToFile("modified", path);
+            fs.rename(path, name + ".old");
+            fs.rm(path + ".old");
+            performed += 4;
+        }
+        Clock::time_point end = Clock::now();
+
+        done.store(true, std::memory_order_release);
+        if (reader.joinable()) reader.join();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        std::cout << std::left << std::setw(10) << count << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(14) << seconds * 1e9 / performed
+                  << std::setw(14) << performed / seconds
+                  << std::setw(12) << events << std::setw(12) << overflows << std::endl;
+    }
+    return 0;
+}
+
+// Resident set size of this process, or 0 where it cannot be read.
+std::uint64_t residentBytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+    return 0;
+#elif defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    std::uint64_t size = 0;
+    std::uint64_t resident = 0;
+    if (!(statm >> size >> resident)) return 0;
+    return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+// A small tenant: four directories of eight short files.
+void populateTenant(FileSystem& fs) {
+    for (int d = 0; d < 4; ++d) {
+        std::string dir = "/d" + std::to_string(d);
+        fs.mkdir(dir);
+        for (int f = 0; f < 8; ++f) {
+            fs.echoToFile("hello tenant", dir + "/file" + std::to_string(f) + ".txt");
+        }
+    }
+}
+
+int openNullDevice() {
+#ifdef _WIN32
+    return _open("NUL", _O_WRONLY);
+#else
+    return open("/dev/null", O_WRONLY);
+#endif
+}
+
+void closeNullDevice(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+// Builds a fanout x fanout x (fanout - 2) tree (990,100 nodes at the default
+// of 100) and times printTree() through each sink: text and NDJSON written
+// to the null device, and a NullSink for the cost of the walk alone.
+int benchTree(std::size_t fanout) {
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+    if (fanout < 3) {
+        std::cerr << "fs_replay: tree fanout must be at least 3" << std::endl;
+        return 1;
+    }
+    int null_fd = openNullDevice();
+    if (null_fd < 0) {
+        std::cerr << "fs_replay: cannot open the null device" << std::endl;
+        return 1;
+    }
+
+    FileSystem fs;
+    fs.setOutput(std::make_unique<NullSink>());
+    Clock::time_point start = Clock::now();
+    for (std::size_t i = 0; i < fanout; ++i) {
+        std::string top = "/d" + std::to_string(i);
+        fs.mkdir(top);
+        for (std::size_t j = 0; j < fanout; ++j) {
+            std::string middle = top + "/s" + std::to_string(j);
+            fs.mkdir(middle);
+            for (std::size_t k = 0; k + 2 < fanout; ++k) {
+                fs.touch(middle + "/f" + std::to_string(k));
+            }
+        }
+    }
+    double build = Milliseconds(Clock::now() - start).count();
+    std::size_t nodes = fanout + fanout * fanout + fanout * fanout * (fanout - 2);
+    std::cout << "built " << nodes << " nodes in " << std::fixed << std::setprecision(0) << build << " ms" << std::endl;
+
+    std::cout << std::left << std::setw(10) << "sink" << std::right
+              << std::setw(12) << "ms" << std::setw(14) << "nodes/s" << std::endl;
+    const char* sinks[] = {"text", "json", "null"};
+    for (int sink = 0; sink < 3; ++sink) {
+        if (sink == 0) fs.setOutput(std::make_unique<TextSink>(null_fd, null_fd));
+        if (sink == 1) fs.setOutput(std::make_unique<JsonSink>(null_fd));
+        if (sink == 2) fs.setOutput(std::make_unique<NullSink>());
+        start = Clock::now();
+        fs.printTree();
+        fs.output().flush();
+        double elapsed = Milliseconds(Clock::now() - start).count();
+        std::cout << std::left << std::setw(10) << sinks[sink] << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(12) << elapsed
+                  << std::setprecision(0) << std::setw(14) << nodes / (elapsed / 1000) << std::endl;
+    }
+    fs.setOutput(std::make_unique<NullSink>());
+    closeNullDevice(null_fd);
+    return 0;
+}
+
+// Creates, populates and destroys `count` tenants, either as namespaces of
+// one NamespaceManager or as independent FileSystem instances sharing only a
+// content store, and reports each phase and the memory per tenant. Run the
+// two modes as separate processes: memory freed by one would be reused by
+// the other and hide its growth.
+int benchNamespaces(std::size_t count, bool managed) {
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        names.push_back("tenant" + std::to_string(i));
+    }
+    const std::int64_t tenants = static_cast<std::int64_t>(std::max<std::size_t>(count, 1));
+
+    NamespaceManager manager;
+    std::shared_ptr<ContentStore> store = std::make_shared<MemoryContentStore>();
+    std::vector<std::unique_ptr<FileSystem>> standalone;
+    standalone.reserve(managed ? 0 : count);
+    std::vector<FileSystem*> filesystems;
+    filesystems.reserve(count);
+
+    std::int64_t base = static_cast<std::int64_t>(residentBytes());
+    Clock::time_point start = Clock::now();
+    for (const std::string& name : names) {
+        FileSystem* fs;
+        if (managed) {
+            fs = manager.create(name);
+        } else {
+            standalone.push_back(std::make_unique<FileSystem>(store));
+            fs = standalone.back().get();
+        }
+        fs->setOutput(std::make_unique<NullSink>());
+        filesystems.push_back(fs);
+    }
+    Clock::time_point created = Clock::now();
+    std::int64_t empty = static_cast<std::int64_t>(residentBytes()) - base;
+
+    for (FileSystem* fs : filesystems) populateTenant(*fs);
+    Clock::time_point populated = Clock::now();
+    std::int64_t full = static_cast<std::int64_t>(residentBytes()) - base;
+
+    FileSystem::Usage usage{0, 0};
+    for (FileSystem* fs : filesystems) {
+        usage.nodes += fs->usage().nodes;
+        usage.bytes += fs->usage().bytes;
+    }
+    std::size_t poolBytes = manager.getNodePool().bytesInUse();
+    std::size_t pooledNames = manager.getNamePool().size();
+
+    filesystems.clear();
+    if (managed) {
+        for (const std::string& name : names) manager.destroy(name);
+    } else {
+        standalone.clear();
+    }
+    Clock::time_point destroyed = Clock::now();
+
+    std::cout << (managed ? "Namespaces" : "Standalone file systems") << ": " << count
+              << " tenants, 36 nodes each once populated" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Create:   " << Milliseconds(created - start).count() << " ms" << std::endl;
+    std::cout << "Populate: " << Milliseconds(populated - created).count() << " ms" << std::endl;
+    std::cout << "Destroy:  " << Milliseconds(destroyed - populated).count() << " ms" << std::endl;
+    if (base == 0) {
+        std::cout << "Resident memory is not available on this platform" << std::endl;
+    } else {
+        std::cout << "Resident memory per tenant: " << empty / tenants << " bytes empty, "
+                  << full / tenants << " bytes populated" << std::endl;
+    }
+    std::cout << "FileSystem object: " << sizeof(FileSystem) << " bytes" << std::endl;
+    std::cout << "Accounted: " << usage.nodes << " nodes, " << usage.bytes << " bytes of content" << std::endl;
+    if (managed) {
+        std::cout << "Node pool: " << poolBytes / static_cast<std::size_t>(tenants) << " bytes per namespace, "
+                  << manager.getNodePool().bytesReserved() << " bytes reserved" << std::endl;
+        std::cout << "Name pool: " << pooledNames << " distinct names" << std::endl;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    if (!args.empty() && args[0] == "--generate") {
+        if (args.size() < 3) {
+            printUsage();
+            return 1;
+        }
+        std::size_t operations = 100000;
+        if (args.size() > 3) operations = static_cast<std::size_t>(std::strtoull(args[3].c_str(), nullptr, 10));
+        return generate(args[1], args[2], operations);
+    }
+
+    if (!args.empty() && args[0] == "--bench") {
+        if (args.size() < 2) {
+            printUsage();
+            return 1;
+        }
+        std::size_t operations = 1000000;
+        if (args.size() > 2) operations = static_cast<std::size_t>(std::strtoull(args[2].c_str(), nullptr, 10));
+        if (args[1] == "transactions") return benchTransactions(args.size() > 2 ? operations : 200000);
+        if (args[1] == "tree") return benchTree(args.size() > 2 ? operations : 100);
+        if (args[1] == "watches") return benchWatches(operations);
+        if (args[1] == "namespaces" || args[1] == "standalone") {
+            return benchNamespaces(args.size() > 2 ? operations : 10000, args[1] == "namespaces");
+        }
+        std::cerr << "fs_replay: unknown benchmark '" << args[1] << "'" << std::endl;
+        return 1;
+    }
+
+    if (args.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    bool paced = false;
+    std::string spill_path;
+    std::size_t budget = 0;
+    for (std::size_t i = 1; i < args.size(); ++i) {
+        if (args[i] == "--paced") {
+            paced = true;
+        } else if (args[i] == "--spill" && i + 1 < args.size()) {
+            spill_path = args[++i];
+        } else if (args[i] == "--budget" && i + 1 < args.size()) {
+            budget = static_cast<std::size_t>(std::strtoull(args[++i].c_str(), nullptr, 10));
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // Replay discards the file system's output; store failures still matter.
+    TextSink diagnostics;
+    std::shared_ptr<ContentStore> store;
+    if (spill_path.empty()) {
+        store = std::make_shared<MemoryContentStore>();
+    } else {
+        store = std::make_shared<SpillContentStore>(spill_path, budget, 64u << 20);
+    }
+    store->setDiagnostics(&diagnostics);
+    return replay(args[0], paced, store);
+}
@@ -3,16 +3,61 @@
 #include <vector>
 #include <sstream>
 #include <algorithm>
+#include <cstdlib>
+#include <memory>
 #include <windows.h>
 #include <conio.h>
 
+#include "../include/content_store.h"
 #include "../include/filesystem.h"
+#include "../include/output_sink.h"
 #include "../include/file.h"
 #include "../include/directory.h"
 #include "../include/filesystem_node.h"
+#include "../include/trace.h"
+#include "../include/watch.h"
 
-int main() {
-    FileSystem fs;
+// Usage: fs [--json] [--spill <backing file> --budget <bytes> [--cache <bytes>]]
+struct ShellOptions {
+    bool json = false;
+    std::string spill_path;
+    std::size_t budget = 0;
+    std::size_t cache = 64u << 20;
+};
+
+ShellOptions parseOptions(int argc, char* argv[]) {
+    ShellOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--json") {
+            options.json = true;
+        } else if (option == "--spill" && i + 1 < argc) {
+            options.spill_path = argv[++i];
+        } else if (option == "--budget" && i + 1 < argc) {
+            options.budget = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if (option == "--cache" && i + 1 < argc) {
+            options.cache = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+        }
+    }
+    return options;
+}
+
+std::shared_ptr<ContentStore> makeContentStore(const ShellOptions& options) {
+    if (options.spill_path.empty()) {
+        return std::make_shared<MemoryContentStore>();
+    }
+    return std::make_shared<SpillContentStore>(options.spill_path, options.budget, options.cache);
+}
+
+int main(int argc, char* argv[]) {
+    ShellOptions options = parseOptions(argc, argv);
+    FileSystem fs(makeContentStore(options));
+    if (options.json) {
+        fs.setOutput(std::make_unique<JsonSink>());
+    }
+    fs.getContentStore().setDiagnostics(&fs.output());
     std::string line;
     std::string command;
     std::string arg1, arg2;
@@ -20,15 +65,26 @@ int main() {
     std::vector<std::string> history;
     int history_index = -1;
 
+    WatchReader watch_reader = fs.watchEvents();
+    WatchEvent watch_event;
+
+    std::unique_ptr<TraceWriter> trace;
+
+    // The banner, prompt and keystroke echo are for the terminal. With
+    // --json, stdout carries only NDJSON records, so they go to stderr.
+    std::ostream& console = options.json ? std::cerr : std::cout;
+
     SetConsoleOutputCP(CP_UTF8);
     SetConsoleCP(CP_UTF8);
 
-    std::cout << "In-Memory File System Simulator" << std::endl;
-    std::cout << "Commands: ls [path], cd <path>, mkdir <path>, touch <path>, rm <path>" << std::endl;
-    std::cout << "          pwd, cat <path>, echo \"text\" > <path>, rename <path> <new_name>, tree, clear, exit" << std::endl;
+    console << "In-Memory File System Simulator" << std::endl;
+    console << "Commands: ls [path], cd <path>, mkdir <path>, touch <path>, rm <path>" << std::endl;
+    console << "          pwd, cat <path>, echo \"text\" > <path>, rename <path> <new_name>, tree, clear, exit" << std::endl;
+    console << "          begin, commit, abort, watch [-r] <path>, unwatch <wd>" << std::endl;
+    console << "          trace <file>, trace off, store" << std::endl;
 
     while (true) {
-        std::cout << "[" << fs.pwd() << "]$ ";
+        console << "[" << fs.currentPath() << "]$ ";
         line.clear();
         while (true) {
             char c = _getch();
@@ -39,10 +95,10 @@ int main() {
 #else
                 system("clear");
 #endif
-                std::cout << "[" << fs.pwd() << "]$ " << line;
+                console << "[" << fs.currentPath() << "]$ " << line;
                 continue;
             } else if (c == '\r') { // ENTER
-                std::cout << std::endl;
+                console << std::endl;
                 if (!line.empty()) {
                     history.push_back(line);
                 }
@@ -51,11 +107,12 @@ int main() {
             } else if (c == 8) { // Backspace
                 if (!line.empty()) {
                     line.pop_back();
-                    std::cout << "\b \b";
+                    console << "\b \b";
                 }
             } else if (c == 9) { // TAB autocomplete
                 std::vector<std::string> commands = {
-                    "ls", "cd", "mkdir", "touch", "rm", "pwd", "cat", "echo", "rename", "tree", "clear", "exit", "neofetch"
+                    "ls", "cd", "mkdir", "touch", "rm", "pwd", "cat", "echo", "rename", "tree", "clear", "exit", "neofetch",
+                    "begin", "commit", "abort", "watch", "unwatch", "trace", "store"
                 };
                 std::stringstream ss(line);
                 std::string firstPart, secondPart;
@@ -80,7 +137,7 @@ int main() {
                 }
                 if (!completion.empty()) {
                     line += completion;
-                    std::cout << completion;
+                    console << completion;
                 }
             } else if (c == -32 || (unsigned char)c == 224) { // Arrow keys
                 char c2 = _getch();
@@ -91,16 +148,16 @@ int main() {
                         }
                         std::string hist_cmd = history[history.size() - 1 - history_index];
                         while (!line.empty()) {
-                            std::cout << "\b \b";
+                            console << "\b \b";
                             line.pop_back();
                         }
                         line = hist_cmd;
-                        std::cout << line;
+                        console << line;
                     }
                 }
             } else {
                 line += c;
-                std::cout << c;
+                console << c;
             }
         }
 
@@ -137,43 +194,43 @@ int main() {
             fs.ls(arg1.empty() ? "." : arg1);
         } else if (command == "cd") {
             if (arg1.empty()) {
-                std::cerr << "cd: missing operand" << std::endl;
+                fs.output().error("cd: missing operand");
             } else {
                 fs.cd(arg1);
             }
         } else if (command == "mkdir") {
             if (arg1.empty()) {
-                std::cerr << "mkdir: missing operand" << std::endl;
+                fs.output().error("mkdir: missing operand");
             } else {
                 fs.mkdir(arg1);
             }
         } else if (command == "touch") {
             if (arg1.empty()) {
-                std::cerr << "touch: missing operand" << std::endl;
+                fs.output().error("touch: missing operand");
             } else {
                 fs.touch(arg1);
             }
         } else if (command == "rm") {
             if (arg1.empty()) {
-                std::cerr << "rm: missing operand" << std::endl;
+                fs.output().error("rm: missing operand");
             } else {
                 fs.rm(arg1);
             }
         } else if (command == "pwd") {
-            std::cout << fs.pwd() << std::endl;
+            fs.output().text(fs.pwd());
         } else if (command == "tree") {
             fs.printTree();
         } else if (command == "clear") {
             system("cls");
         } else if (command == "cat") {
             if (arg1.empty()) {
-                std::cerr << "cat: missing operand" << std::endl;
+                fs.output().error("cat: missing operand");
             } else {
                 fs.cat(arg1);
             }
         } else if (command == "echo") {
             if (arg1.empty()) {
-                std::cerr << "echo: missing output file" << std::endl;
+                fs.output().error("echo: missing output file");
             } else {
                 fs.echoToFile(arg2, arg1);
             }
@@ -181,15 +238,64 @@ int main() {
             fs.neofetch();
         } else if (command == "rename") {
             if (arg1.empty() || arg2.empty()) {
-                std::cerr << "rename: missing operand" << std::endl;
+                fs.output().error("rename: missing operand");
             } else {
                 fs.rename(arg1, arg2);
             }
+        } else if (command == "begin") {
+            fs.begin();
+        } else if (command == "commit") {
+            fs.commit();
+        } else if (command == "abort") {
+            fs.abort();
+        } else if (command == "watch") {
+            bool recursive = (arg1 == "-r");
+            std::string target = recursive ? arg2 : arg1;
+            if (target.empty()) {
+                fs.output().error("watch: missing operand");
+            } else {
+                int wd = fs.addWatch(target, recursive);
+                if (wd >= 0) {
+                    fs.output().text("watch: " + std::to_string(wd) + " on '" + target + "'" + (recursive ? " (recursive)" : ""));
+                }
+            }
+        } else if (command == "unwatch") {
+            if (arg1.empty()) {
+                fs.output().error("unwatch: missing operand");
+            } else {
+                fs.removeWatch(std::atoi(arg1.c_str()));
+            }
+        } else if (command == "store") {
+            fs.printContentStats();
+        } else if (command == "trace") {
+            if (arg1.empty()) {
+                fs.output().error("trace: missing operand");
+            } else if (arg1 == "off") {
+                fs.setTrace(nullptr);
+                trace.reset();
+            } else {
+                fs.setTrace(nullptr);
+                trace = std::make_unique<TraceWriter>(arg1);
+                if (!trace->isOpen()) {
+                    fs.output().error("trace: cannot open '" + arg1 + "'");
+                    trace.reset();
+                } else {
+                    fs.setTrace(trace.get());
+                }
+            }
         } else if (command.empty()) {
             // do nothing
         } else {
-            std::cerr << "Command not found: " << command << std::endl;
+            fs.output().error("Command not found: " + command);
+        }
+
+        while (watch_reader.next(watch_event)) {
+            std::string message = "[watch " + std::to_string(watch_event.wd) + "] " + describeWatchMask(watch_event.mask);
+            if (!watch_event.name.empty()) message += " " + watch_event.name;
+            if (watch_event.cookie != 0) message += " (cookie " + std::to_string(watch_event.cookie) + ")";
+            fs.output().text(message);
         }
+        fs.output().flush();
     }
 
     return 0;
@@ -0,0 +1,22 @@
+#include "../include/name_pool.h"
+
+NamePool::NamePool() = default;
+
+const std::string* NamePool::intern(const std::string& name) {
+    // Keys of an unordered_map never move, so their address is the handle.
+    auto it = references_.emplace(name, 0).first;
+    ++it->second;
+    return &it->first;
+}
+
+void NamePool::release(const std::string* name) {
+    auto it = references_.find(*name);
+    if (it == references_.end()) return;
+    if (--it->second == 0) {
+        references_.erase(it);
+    }
+}
+
+std::size_t NamePool::size() const {
+    return references_.size();
+}
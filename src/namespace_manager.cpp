@@ -0,0 +1,80 @@
+#include "../include/namespace_manager.h"
+
+NamespaceManager::NamespaceManager()
+    : NamespaceManager(std::make_shared<MemoryContentStore>()) {}
+
+NamespaceManager::NamespaceManager(std::shared_ptr<ContentStore> content_store)
+    : content_store_(std::move(content_store)),
+      names_(std::make_shared<NamePool>()),
+      nodes_(std::make_shared<NodePool>()) {}
+
+NamespaceManager::~NamespaceManager() = default;
+
+FileSystem* NamespaceManager::create(const std::string& name) {
+    return create(name, FileSystem::Quota{0, 0, 0, 0});
+}
+
+FileSystem* NamespaceManager::create(const std::string& name, const FileSystem::Quota& quota) {
+    auto it = namespaces_.find(name);
+    if (it != namespaces_.end()) {
+        return nullptr;
+    }
+    auto fs = std::make_unique<FileSystem>(content_store_, names_, nodes_);
+    fs->setQuota(quota);
+    FileSystem* created = fs.get();
+    namespaces_.emplace(name, std::move(fs));
+    return created;
+}
+
+FileSystem* NamespaceManager::get(const std::string& name) const {
+    auto it = namespaces_.find(name);
+    if (it == namespaces_.end()) {
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+bool NamespaceManager::destroy(const std::string& name) {
+    auto it = namespaces_.find(name);
+    if (it == namespaces_.end()) {
+        return false;
+    }
+    // Nodes go back to the shared pool's free lists, ready for the next
+    // namespace, and their contents are released from the shared store.
+    namespaces_.erase(it);
+    return true;
+}
+
+std::size_t NamespaceManager::size() const {
+    return namespaces_.size();
+}
+
+std::vector<std::string> NamespaceManager::names() const {
+    std::vector<std::string> result;
+    result.reserve(namespaces_.size());
+    for (const auto& pair : namespaces_) {
+        result.push_back(pair.first);
+    }
+    return result;
+}
+
+FileSystem::Usage NamespaceManager::totalUsage() const {
+    FileSystem::Usage total{0, 0};
+    for (const auto& pair : namespaces_) {
+        total.nodes += pair.second->usage().nodes;
+        total.bytes += pair.second->usage().bytes;
+    }
+    return total;
+}
+
+ContentStore& NamespaceManager::getContentStore() const {
+    return *content_store_;
+}
+
+const NamePool& NamespaceManager::getNamePool() const {
+    return *names_;
+}
+
+const NodePool& NamespaceManager::getNodePool() const {
+    return *nodes_;
+}
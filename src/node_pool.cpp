@@ -0,0 +1,75 @@
+#include "../include/node_pool.h"
+
+#include <new>
+
+const std::size_t NodePool::kGranularity;
+const std::size_t NodePool::kMaxSize;
+const std::size_t NodePool::kSlabSize;
+
+NodePool::NodePool()
+    : free_lists_(kMaxSize / kGranularity, nullptr),
+      cursor_(nullptr),
+      remaining_(0),
+      in_use_(0),
+      large_bytes_(0) {}
+
+std::size_t NodePool::classOf(std::size_t size) {
+    return (size + kGranularity - 1) / kGranularity - 1;
+}
+
+void* NodePool::allocate(std::size_t size) {
+    if (size == 0) size = 1;
+    if (size > kMaxSize) {
+        large_bytes_ += size;
+        in_use_ += size;
+        return ::operator new(size);
+    }
+
+    std::size_t sizeClass = classOf(size);
+    std::size_t rounded = (sizeClass + 1) * kGranularity;
+    in_use_ += rounded;
+
+    FreeBlock*& head = free_lists_[sizeClass];
+    if (head) {
+        FreeBlock* block = head;
+        head = block->next;
+        return block;
+    }
+
+    if (remaining_ < rounded) {
+        // The tail of the old slab is too small for this class; it goes
+        // unused rather than being split across classes.
+        slabs_.emplace_back(new char[kSlabSize]);
+        cursor_ = slabs_.back().get();
+        remaining_ = kSlabSize;
+    }
+    void* pointer = cursor_;
+    cursor_ += rounded;
+    remaining_ -= rounded;
+    return pointer;
+}
+
+void NodePool::deallocate(void* pointer, std::size_t size) {
+    if (!pointer) return;
+    if (size == 0) size = 1;
+    if (size > kMaxSize) {
+        large_bytes_ -= size;
+        in_use_ -= size;
+        ::operator delete(pointer);
+        return;
+    }
+
+    std::size_t sizeClass = classOf(size);
+    in_use_ -= (sizeClass + 1) * kGranularity;
+    FreeBlock* block = static_cast<FreeBlock*>(pointer);
+    block->next = free_lists_[sizeClass];
+    free_lists_[sizeClass] = block;
+}
+
+std::size_t NodePool::bytesInUse() const {
+    return in_use_;
+}
+
+std::size_t NodePool::bytesReserved() const {
+    return slabs_.size() * kSlabSize + large_bytes_;
+}
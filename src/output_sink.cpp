@@ -0,0 +1,247 @@
+#include "../include/output_sink.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const std::size_t kChunkSize = 64 * 1024;
+const std::size_t kMaxChunks = 16;
+
+void writeAll(int fd, const char* data, std::size_t length) {
+    while (length > 0) {
+#ifdef _WIN32
+        int written = _write(fd, data, static_cast<unsigned>(std::min<std::size_t>(length, 1u << 30)));
+#else
+        ssize_t written = ::write(fd, data, length);
+#endif
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += written;
+        length -= static_cast<std::size_t>(written);
+    }
+}
+
+} // namespace
+
+OutputSink::~OutputSink() = default;
+
+BufferedWriter::BufferedWriter(int fd)
+    : fd_(fd), used_(0) {}
+
+BufferedWriter::~BufferedWriter() {
+    flush();
+}
+
+void BufferedWriter::append(const char* data, std::size_t length) {
+    while (length > 0) {
+        std::string& chunk = current();
+        std::size_t count = std::min(length, kChunkSize - chunk.size());
+        chunk.append(data, count);
+        data += count;
+        length -= count;
+    }
+}
+
+void BufferedWriter::append(const std::string& data) {
+    append(data.data(), data.size());
+}
+
+void BufferedWriter::append(char c) {
+    current().push_back(c);
+}
+
+void BufferedWriter::flush() {
+    if (used_ == 0) return;
+
+#ifdef _WIN32
+    for (std::size_t i = 0; i < used_; ++i) {
+        writeAll(fd_, chunks_[i].data(), chunks_[i].size());
+    }
+#else
+    struct iovec iov[kMaxChunks];
+    int count = 0;
+    for (std::size_t i = 0; i < used_; ++i) {
+        if (chunks_[i].empty()) continue;
+        iov[count].iov_base = &chunks_[i][0];
+        iov[count].iov_len = chunks_[i].size();
+        ++count;
+    }
+
+    int first = 0;
+    while (first < count) {
+        ssize_t written = ::writev(fd_, iov + first, count - first);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        // Skip whatever the kernel took, which may end inside a chunk.
+        std::size_t remaining = static_cast<std::size_t>(written);
+        while (first < count && remaining >= iov[first].iov_len) {
+            remaining -= iov[first].iov_len;
+            ++first;
+        }
+        if (first < count) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+            iov[first].iov_len -= remaining;
+        }
+    }
+#endif
+
+    for (std::size_t i = 0; i < used_; ++i) {
+        chunks_[i].clear();
+    }
+    used_ = 0;
+}
+
+std::string& BufferedWriter::current() {
+    if (used_ > 0 && chunks_[used_ - 1].size() < kChunkSize) {
+        return chunks_[used_ - 1];
+    }
+    if (used_ == kMaxChunks) flush();
+    if (chunks_.size() == used_) {
+        chunks_.emplace_back();
+        chunks_.back().reserve(kChunkSize);
+    }
+    return chunks_[used_++];
+}
+
+TextSink::TextSink(int out_fd, int err_fd)
+    : out_(out_fd), err_fd_(err_fd) {}
+
+void TextSink::text(const std::string& line) {
+    out_.append(line);
+    out_.append('\n');
+}
+
+void TextSink::error(const std::string& message) {
+    out_.flush();
+    std::string line = message + "\n";
+    writeAll(err_fd_, line.data(), line.size());
+}
+
+void TextSink::entry(const std::string& name, bool directory) {
+    out_.append(name);
+    if (directory) out_.append('/');
+    out_.append('\n');
+}
+
+void TextSink::treeBegin() {
+    out_.append("--- File System Tree ---\n");
+}
+
+void TextSink::treeNode(int depth, const std::string& name, bool directory, std::size_t size) {
+    static const std::string kIndent(64, ' ');
+    std::size_t indent = static_cast<std::size_t>(depth) * 2;
+    while (indent > 0) {
+        std::size_t count = std::min(indent, kIndent.size());
+        out_.append(kIndent.data(), count);
+        indent -= count;
+    }
+
+    if (directory) {
+        out_.append("+ ");
+        out_.append(name);
+        out_.append(" (Directory)\n");
+    } else {
+        out_.append("- ");
+        out_.append(name);
+        out_.append(" (File, size=");
+        out_.append(std::to_string(size));
+        out_.append(")\n");
+    }
+}
+
+void TextSink::treeEnd() {
+    out_.append("------------------------\n");
+}
+
+void TextSink::flush() {
+    out_.flush();
+}
+
+JsonSink::JsonSink(int fd)
+    : out_(fd) {}
+
+void JsonSink::text(const std::string& line) {
+    out_.append("{\"type\":\"text\",\"text\":");
+    appendString(line);
+    out_.append("}\n");
+}
+
+void JsonSink::error(const std::string& message) {
+    out_.append("{\"type\":\"error\",\"message\":");
+    appendString(message);
+    out_.append("}\n");
+}
+
+void JsonSink::entry(const std::string& name, bool directory) {
+    out_.append("{\"type\":\"entry\",\"name\":");
+    appendString(name);
+    out_.append(directory ? ",\"directory\":true}\n" : ",\"directory\":false}\n");
+}
+
+void JsonSink::treeBegin() {
+    out_.append("{\"type\":\"tree_begin\"}\n");
+}
+
+void JsonSink::treeNode(int depth, const std::string& name, bool directory, std::size_t size) {
+    out_.append("{\"type\":\"node\",\"depth\":");
+    out_.append(std::to_string(depth));
+    out_.append(",\"name\":");
+    appendString(name);
+    out_.append(directory ? ",\"directory\":true" : ",\"directory\":false");
+    if (!directory) {
+        out_.append(",\"size\":");
+        out_.append(std::to_string(size));
+    }
+    out_.append("}\n");
+}
+
+void JsonSink::treeEnd() {
+    out_.append("{\"type\":\"tree_end\"}\n");
+}
+
+void JsonSink::flush() {
+    out_.flush();
+}
+
+void JsonSink::appendString(const std::string& value) {
+    out_.append('"');
+    for (char c : value) {
+        switch (c) {
+            case '"': out_.append("\\\""); break;
+            case '\\': out_.append("\\\\"); break;
+            case '\n': out_.append("\\n"); break;
+            case '\r': out_.append("\\r"); break;
+            case '\t': out_.append("\\t"); break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                    out_.append(escaped);
+                } else {
+                    out_.append(c);
+                }
+        }
+    }
+    out_.append('"');
+}
+
+void NullSink::text(const std::string&) {}
+void NullSink::error(const std::string&) {}
+void NullSink::entry(const std::string&, bool) {}
+void NullSink::treeBegin() {}
+void NullSink::treeNode(int, const std::string&, bool, std::size_t) {}
+void NullSink::treeEnd() {}
+void NullSink::flush() {}
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "../include/trace.h"
+
+#include <iterator>
+
+namespace {
+
+const char kTraceMagic[] = "FSTRACE1";
+const std::size_t kTraceMagicLength = sizeof(kTraceMagic) - 1;
+const std::size_t kFlushThreshold = 1 << 16;
+const std::uint8_t kResultBit = 0x80;
+
+} // namespace
+
+const char* traceOpName(TraceOp op) {
+    switch (op) {
+        case TraceOp::Pwd: return "pwd";
+        case TraceOp::Ls: return "ls";
+        case TraceOp::Cd: return "cd";
+        case TraceOp::Mkdir: return "mkdir";
+        case TraceOp::Touch: return "touch";
+        case TraceOp::Rm: return "rm";
+        case TraceOp::Cat: return "cat";
+        case TraceOp::Echo: return "echo";
+        case TraceOp::Rename: return "rename";
+        case TraceOp::Tree: return "tree";
+        case TraceOp::Begin: return "begin";
+        case TraceOp::Commit: return "commit";
+        case TraceOp::Abort: return "abort";
+        case TraceOp::Count: break;
+    }
+    return "unknown";
+}
+
+int traceOpArgumentCount(TraceOp op) {
+    switch (op) {
+        case TraceOp::Ls:
+        case TraceOp::Cd:
+        case TraceOp::Mkdir:
+        case TraceOp::Touch:
+        case TraceOp::Rm:
+        case TraceOp::Cat:
+            return 1;
+        case TraceOp::Echo:
+        case TraceOp::Rename:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+TraceWriter::TraceWriter(const std::string& path)
+    : out_(path, std::ios::binary | std::ios::trunc),
+      start_(std::chrono::steady_clock::now()),
+      last_timestamp_ns_(0),
+      record_count_(0) {
+    buffer_.reserve(kFlushThreshold * 2);
+    buffer_.append(kTraceMagic, kTraceMagicLength);
+}
+
+TraceWriter::~TraceWriter() {
+    flush();
+}
+
+bool TraceWriter::isOpen() const {
+    return out_.is_open();
+}
+
+std::uint64_t TraceWriter::now() const {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count());
+}
+
+void TraceWriter::record(TraceOp op, bool result, std::uint64_t timestamp_ns,
+                         const std::string& arg1, const std::string& arg2) {
+    if (timestamp_ns < last_timestamp_ns_) timestamp_ns = last_timestamp_ns_;
+
+    buffer_.push_back(static_cast<char>(static_cast<std::uint8_t>(op) | (result ? kResultBit : 0)));
+    putVarint(timestamp_ns - last_timestamp_ns_);
+    last_timestamp_ns_ = timestamp_ns;
+
+    int argc = traceOpArgumentCount(op);
+    if (argc > 0) putString(arg1);
+    if (argc > 1) putString(arg2);
+
+    ++record_count_;
+    if (buffer_.size() >= kFlushThreshold) flush();
+}
+
+void TraceWriter::flush() {
+    if (!out_.is_open()) buffer_.clear();
+    if (buffer_.empty()) return;
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    out_.flush();
+    buffer_.clear();
+}
+
+std::size_t TraceWriter::recordCount() const {
+    return record_count_;
+}
+
+void TraceWriter::putVarint(std::uint64_t value) {
+    while (value >= 0x80) {
+        buffer_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    buffer_.push_back(static_cast<char>(value));
+}
+
+void TraceWriter::putString(const std::string& value) {
+    putVarint(value.size());
+    buffer_.append(value);
+}
+
+TraceReader::TraceReader(const std::string& path)
+    : offset_(0), timestamp_ns_(0), open_(false), corrupted_(false) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return;
+    data_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (data_.compare(0, kTraceMagicLength, kTraceMagic) != 0) {
+        corrupted_ = true;
+        return;
+    }
+    offset_ = kTraceMagicLength;
+    open_ = true;
+}
+
+bool TraceReader::isOpen() const {
+    return open_;
+}
+
+bool TraceReader::next(TraceRecord& record) {
+    if (!open_ || corrupted_ || offset_ >= data_.size()) return false;
+
+    std::uint8_t tag = static_cast<std::uint8_t>(data_[offset_++]);
+    std::uint8_t op = tag & static_cast<std::uint8_t>(~kResultBit);
+    if (op >= static_cast<std::uint8_t>(TraceOp::Count)) {
+        corrupted_ = true;
+        return false;
+    }
+    record.op = static_cast<TraceOp>(op);
+    record.result = (tag & kResultBit) != 0;
+
+    std::uint64_t delta = 0;
+    if (!getVarint(delta)) return false;
+    timestamp_ns_ += delta;
+    record.timestamp_ns = timestamp_ns_;
+
+    int argc = traceOpArgumentCount(record.op);
+    record.arg1.clear();
+    record.arg2.clear();
+    if (argc > 0 && !getString(record.arg1)) return false;
+    if (argc > 1 && !getString(record.arg2)) return false;
+    return true;
+}
+
+bool TraceReader::corrupted() const {
+    return corrupted_;
+}
+
+bool TraceReader::getVarint(std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (offset_ >= data_.size()) break;
+        std::uint8_t byte = static_cast<std::uint8_t>(data_[offset_++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    corrupted_ = true;
+    return false;
+}
+
+bool TraceReader::getString(std::string& value) {
+    std::uint64_t length = 0;
+    if (!getVarint(length)) return false;
+    if (length > data_.size() - offset_) {
+        corrupted_ = true;
+        return false;
+    }
+    value.assign(data_, offset_, static_cast<std::size_t>(length));
+    offset_ += static_cast<std::size_t>(length);
+    return true;
+}
\ No newline at end of file
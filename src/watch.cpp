@@ -0,0 +1,288 @@
+#include "../include/watch.h"
+#include "../include/directory.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const std::uint16_t kSelfEvents = WatchModify | WatchAttrib;
+
+std::size_t roundUpToPowerOfTwo(std::size_t value) {
+    std::size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+} // namespace
+
+std::string describeWatchMask(std::uint16_t mask) {
+    static const struct {
+        std::uint16_t bit;
+        const char* name;
+    } kNames[] = {
+        {WatchCreate, "CREATE"},       {WatchDelete, "DELETE"},          {WatchModify, "MODIFY"},
+        {WatchAttrib, "ATTRIB"},       {WatchMovedFrom, "MOVED_FROM"},   {WatchMovedTo, "MOVED_TO"},
+        {WatchDeleteSelf, "DELETE_SELF"}, {WatchIgnored, "IGNORED"},     {WatchIsDir, "ISDIR"},
+        {WatchTruncated, "TRUNCATED"}, {WatchOverflow, "Q_OVERFLOW"},
+    };
+
+    std::string result;
+    for (const auto& entry : kNames) {
+        if (mask & entry.bit) {
+            if (!result.empty()) result += "|";
+            result += entry.name;
+        }
+    }
+    return result;
+}
+
+EventRing::EventRing(std::size_t capacity)
+    : capacity_(roundUpToPowerOfTwo(std::max<std::size_t>(capacity, 2))), head_(0), coalesced_(0) {}
+
+void EventRing::reserve() {
+    if (slots_) return;
+    slots_.reset(new Slot[capacity_]);
+    for (std::size_t i = 0; i < capacity_; ++i) {
+        slots_[i].sequence.store(0, std::memory_order_relaxed);
+        slots_[i].header.store(0, std::memory_order_relaxed);
+        slots_[i].cookie.store(0, std::memory_order_relaxed);
+        slots_[i].consumed.store(0, std::memory_order_relaxed);
+        for (std::size_t w = 0; w < kNameWords; ++w) {
+            slots_[i].name[w].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void EventRing::publish(int wd, std::uint16_t mask, std::uint32_t cookie, const std::string& name) {
+    reserve();
+
+    std::size_t length = std::min(name.size(), kNameWords * sizeof(std::uint64_t));
+    if (length < name.size()) mask |= WatchTruncated;
+
+    std::uint64_t words[kNameWords] = {};
+    std::memcpy(words, name.data(), length);
+    std::uint64_t header = static_cast<std::uint32_t>(wd)
+                         | (static_cast<std::uint64_t>(mask) << 32)
+                         | (static_cast<std::uint64_t>(length) << 48);
+
+    std::uint64_t pos = head_.load(std::memory_order_relaxed);
+
+    // Like inotify, a write identical to the newest event that nobody has
+    // read yet is folded into it. Readers claim a slot before copying it, so
+    // a reader that has started on the slot always makes this check fail
+    // and the write gets an event of its own.
+    if ((mask & WatchModify) && pos != 0) {
+        const Slot& last = slots_[(pos - 1) & (capacity_ - 1)];
+        if (last.consumed.load(std::memory_order_seq_cst) == 0 &&
+            last.header.load(std::memory_order_relaxed) == header) {
+            bool same = true;
+            for (std::size_t w = 0; w < kNameWords && same; ++w) {
+                same = last.name[w].load(std::memory_order_relaxed) == words[w];
+            }
+            if (same) {
+                ++coalesced_;
+                return;
+            }
+        }
+    }
+
+    Slot& slot = slots_[pos & (capacity_ - 1)];
+    slot.sequence.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.header.store(header, std::memory_order_relaxed);
+    slot.cookie.store(cookie, std::memory_order_relaxed);
+    slot.consumed.store(0, std::memory_order_relaxed);
+    for (std::size_t w = 0; w < kNameWords; ++w) {
+        slot.name[w].store(words[w], std::memory_order_relaxed);
+    }
+    slot.sequence.store(2 * pos + 2, std::memory_order_release);
+    head_.store(pos + 1, std::memory_order_release);
+}
+
+bool EventRing::read(std::uint64_t& cursor, WatchEvent& event) const {
+    std::uint64_t head = head_.load(std::memory_order_acquire);
+    if (cursor >= head) return false;
+
+    bool lapped = head - cursor > capacity_;
+    std::uint64_t header = 0;
+    std::uint32_t cookie = 0;
+    std::uint64_t words[kNameWords];
+
+    if (!lapped) {
+        const Slot& slot = slots_[cursor & (capacity_ - 1)];
+        const std::uint64_t expected = 2 * cursor + 2;
+        if (slot.sequence.load(std::memory_order_acquire) != expected) {
+            lapped = true;
+        } else {
+            // Claim first: once this is visible the producer will not fold
+            // a newer write into an event this reader is about to return.
+            // If the slot is then overwritten the claim is harmless.
+            slot.consumed.exchange(1, std::memory_order_seq_cst);
+            header = slot.header.load(std::memory_order_relaxed);
+            cookie = slot.cookie.load(std::memory_order_relaxed);
+            for (std::size_t w = 0; w < kNameWords; ++w) {
+                words[w] = slot.name[w].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            lapped = slot.sequence.load(std::memory_order_relaxed) != expected;
+        }
+    }
+
+    if (lapped) {
+        event.wd = -1;
+        event.mask = WatchOverflow;
+        event.cookie = 0;
+        event.name.clear();
+        cursor = head_.load(std::memory_order_acquire);
+        return true;
+    }
+
+    std::size_t length = static_cast<std::size_t>(header >> 48);
+    event.wd = static_cast<int>(static_cast<std::uint32_t>(header));
+    event.mask = static_cast<std::uint16_t>(header >> 32);
+    event.cookie = cookie;
+    event.name.assign(reinterpret_cast<const char*>(words), length);
+    ++cursor;
+    return true;
+}
+
+std::uint64_t EventRing::head() const {
+    return head_.load(std::memory_order_acquire);
+}
+
+std::uint64_t EventRing::coalesced() const {
+    return coalesced_;
+}
+
+WatchReader::WatchReader(const EventRing* ring)
+    : ring_(ring), cursor_(ring->head()) {}
+
+bool WatchReader::next(WatchEvent& event) {
+    return ring_->read(cursor_, event);
+}
+
+WatchManager::WatchManager()
+    : recursive_count_(0), next_wd_(1), next_cookie_(1), deferring_(false) {}
+
+int WatchManager::add(const FileSystemNode* node, bool recursive) {
+    ring_.reserve();
+    int wd = next_wd_++;
+    watches_[wd] = node;
+    by_node_.emplace(node, WatchEntry{wd, recursive});
+    if (recursive) ++recursive_count_;
+    return wd;
+}
+
+bool WatchManager::remove(int wd) {
+    auto it = watches_.find(wd);
+    if (it == watches_.end()) return false;
+    unlink(wd, it->second);
+    watches_.erase(it);
+    // The watch table is not transactional: the watch is gone whatever the
+    // transaction does, so its IGNORED must not be held with the tree's events.
+    ring_.publish(wd, WatchIgnored, 0, std::string());
+    return true;
+}
+
+WatchReader WatchManager::subscribe() const {
+    return WatchReader(&ring_);
+}
+
+void WatchManager::notify(const FileSystemNode* node, std::uint16_t mask, std::uint32_t cookie) {
+    if (node->isDirectory()) mask |= WatchIsDir;
+
+    if (mask & kSelfEvents) {
+        auto range = by_node_.equal_range(node);
+        for (auto it = range.first; it != range.second; ++it) {
+            emit(it->second.wd, mask, cookie, std::string());
+        }
+    }
+
+    // Walk up only as far as a recursive watch could still match.
+    std::string relative = node->getName();
+    bool direct = true;
+    for (const Directory* dir = node->getParent(); dir != nullptr; dir = dir->getParent()) {
+        auto range = by_node_.equal_range(dir);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (direct || it->second.recursive) {
+                emit(it->second.wd, mask, cookie, relative);
+            }
+        }
+        if (recursive_count_ == 0 || dir->getParent() == nullptr) break;
+        relative = dir->getName() + "/" + relative;
+        direct = false;
+    }
+}
+
+void WatchManager::forget(const FileSystemNode* root) {
+    // A file can only be watched itself; only directories need the full scan.
+    if (!root->isDirectory()) {
+        auto range = by_node_.equal_range(root);
+        std::vector<int> wds;
+        for (auto it = range.first; it != range.second; ++it) wds.push_back(it->second.wd);
+        for (int wd : wds) {
+            unlink(wd, root);
+            watches_.erase(wd);
+            emit(wd, WatchDeleteSelf, 0, std::string());
+            emit(wd, WatchIgnored, 0, std::string());
+        }
+        return;
+    }
+
+    for (auto it = watches_.begin(); it != watches_.end();) {
+        const FileSystemNode* node = it->second;
+        while (node != nullptr && node != root) {
+            node = node->getParent();
+        }
+        if (node == nullptr) {
+            ++it;
+            continue;
+        }
+        int wd = it->first;
+        unlink(wd, it->second);
+        it = watches_.erase(it);
+        emit(wd, WatchDeleteSelf, 0, std::string());
+        emit(wd, WatchIgnored, 0, std::string());
+    }
+}
+
+std::uint32_t WatchManager::nextCookie() {
+    return next_cookie_++;
+}
+
+void WatchManager::defer() {
+    deferring_ = true;
+}
+
+void WatchManager::flushDeferred() {
+    deferring_ = false;
+    for (const WatchEvent& event : deferred_) {
+        ring_.publish(event.wd, event.mask, event.cookie, event.name);
+    }
+    deferred_.clear();
+}
+
+void WatchManager::discardDeferred() {
+    deferring_ = false;
+    deferred_.clear();
+}
+
+void WatchManager::emit(int wd, std::uint16_t mask, std::uint32_t cookie, const std::string& name) {
+    if (deferring_) {
+        deferred_.push_back(WatchEvent{wd, mask, cookie, name});
+    } else {
+        ring_.publish(wd, mask, cookie, name);
+    }
+}
+
+void WatchManager::unlink(int wd, const FileSystemNode* node) {
+    auto range = by_node_.equal_range(node);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.wd == wd) {
+            if (it->second.recursive) --recursive_count_;
+            by_node_.erase(it);
+            return;
+        }
+    }
+}
\ No newline at end of file